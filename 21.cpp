@@ -1,61 +1,163 @@
 #include <stdio.h>
 #include <string.h>
+#include <openssl/aes.h>
 
-
-#define AES_BLOCK_SIZE 16
+#include "aes_cipher.h"
+#include "block_modes.h"
+#include "gcm.h"
 
 // Function to encrypt using AES in ECB mode
 void aes_ecb_encrypt(const unsigned char *plaintext, int plaintext_len, unsigned char *key, unsigned char *ciphertext) {
-    AES_KEY aes_key;
-    AES_set_encrypt_key(key, 128, &aes_key);
-    
-    for (int i = 0; i < plaintext_len; i += AES_BLOCK_SIZE) {
-        AES_encrypt(plaintext + i, ciphertext + i, &aes_key);
-    }
+    aes128_cipher aes(key);
+    ecb_encrypt(aes, plaintext, ciphertext, plaintext_len);
 }
 
 // Function to decrypt using AES in ECB mode
 void aes_ecb_decrypt(const unsigned char *ciphertext, int ciphertext_len, unsigned char *key, unsigned char *plaintext) {
-    AES_KEY aes_key;
-    AES_set_decrypt_key(key, 128, &aes_key);
-    
-    for (int i = 0; i < ciphertext_len; i += AES_BLOCK_SIZE) {
-        AES_decrypt(ciphertext + i, plaintext + i, &aes_key);
-    }
+    aes128_cipher aes(key);
+    ecb_decrypt(aes, ciphertext, plaintext, ciphertext_len);
 }
 
 // Function to encrypt using AES in CBC mode
 void aes_cbc_encrypt(const unsigned char *plaintext, int plaintext_len, unsigned char *key, unsigned char *iv, unsigned char *ciphertext) {
-    AES_KEY aes_key;
-    AES_set_encrypt_key(key, 128, &aes_key);
-    
-    AES_cbc_encrypt(plaintext, ciphertext, plaintext_len, &aes_key, iv, AES_ENCRYPT);
+    aes128_cipher aes(key);
+    cbc_encrypt(aes, iv, plaintext, ciphertext, plaintext_len);
 }
 
 // Function to decrypt using AES in CBC mode
 void aes_cbc_decrypt(const unsigned char *ciphertext, int ciphertext_len, unsigned char *key, unsigned char *iv, unsigned char *plaintext) {
-    AES_KEY aes_key;
-    AES_set_decrypt_key(key, 128, &aes_key);
-    
-    AES_cbc_encrypt(ciphertext, plaintext, ciphertext_len, &aes_key, iv, AES_DECRYPT);
+    aes128_cipher aes(key);
+    cbc_decrypt(aes, iv, ciphertext, plaintext, ciphertext_len);
 }
 
 // Function to encrypt using AES in CFB mode
 void aes_cfb_encrypt(const unsigned char *plaintext, int plaintext_len, unsigned char *key, unsigned char *iv, unsigned char *ciphertext) {
-    AES_KEY aes_key;
-    AES_set_encrypt_key(key, 128, &aes_key);
-    
-    int num = 0;
-    AES_cfb128_encrypt(plaintext, ciphertext, plaintext_len, &aes_key, iv, &num, AES_ENCRYPT);
+    aes128_cipher aes(key, AES_ENCRYPT_ONLY);
+    cfb_encrypt(aes, iv, plaintext, ciphertext, plaintext_len);
 }
 
 // Function to decrypt using AES in CFB mode
 void aes_cfb_decrypt(const unsigned char *ciphertext, int ciphertext_len, unsigned char *key, unsigned char *iv, unsigned char *plaintext) {
-    AES_KEY aes_key;
-    AES_set_encrypt_key(key, 128, &aes_key);
-    
-    int num = 0;
-    AES_cfb128_encrypt(ciphertext, plaintext, ciphertext_len, &aes_key, iv, &num, AES_DECRYPT);
+    aes128_cipher aes(key, AES_ENCRYPT_ONLY);
+    cfb_decrypt(aes, iv, ciphertext, plaintext, ciphertext_len);
+}
+
+// Function to encrypt and authenticate using AES in GCM mode
+void aes_gcm_encrypt(const unsigned char *plaintext, int plaintext_len, const unsigned char *aad, int aad_len, unsigned char *key, const unsigned char *iv, int iv_len, unsigned char *ciphertext, unsigned char *tag) {
+    aes128_cipher aes(key, AES_ENCRYPT_ONLY);
+    gcm_key<aes128_cipher> gkey;
+    gcm_context<aes128_cipher> ctx;
+    gcm_key_init(&gkey, aes);
+    gcm_start(&ctx, &gkey, iv, iv_len);
+    gcm_aad(&ctx, aad, aad_len);
+    gcm_encrypt(&ctx, plaintext, ciphertext, plaintext_len);
+    gcm_finish(&ctx, tag, GCM_TAG_SIZE);
+}
+
+// Function to decrypt using AES in GCM mode. Returns 0 if the tag is valid;
+// otherwise the plaintext is wiped and -1 is returned.
+int aes_gcm_decrypt(const unsigned char *ciphertext, int ciphertext_len, const unsigned char *aad, int aad_len, unsigned char *key, const unsigned char *iv, int iv_len, const unsigned char *tag, unsigned char *plaintext) {
+    aes128_cipher aes(key, AES_ENCRYPT_ONLY);
+    gcm_key<aes128_cipher> gkey;
+    gcm_context<aes128_cipher> ctx;
+    gcm_key_init(&gkey, aes);
+    gcm_start(&ctx, &gkey, iv, iv_len);
+    gcm_aad(&ctx, aad, aad_len);
+    gcm_decrypt(&ctx, ciphertext, plaintext, ciphertext_len);
+    if (gcm_check(&ctx, tag, GCM_TAG_SIZE) != 0) {
+        memset(plaintext, 0, ciphertext_len);
+        return -1;
+    }
+    return 0;
+}
+
+// AES-128 test cases 1-6 from the GCM specification (McGrew and Viega), also
+// used in NIST's GCM validation
+struct gcm_test_vector {
+    const char *key, *iv, *plaintext, *aad, *ciphertext, *tag;
+};
+
+static const gcm_test_vector gcm_tests[] = {
+    {"00000000000000000000000000000000", "000000000000000000000000", "", "", "",
+     "58e2fccefa7e3061367f1d57a4e7455a"},
+    {"00000000000000000000000000000000", "000000000000000000000000", "00000000000000000000000000000000", "",
+     "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf"},
+    {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+     "",
+     "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+     "4d5c2af327cd64a62cf35abd2ba6fab4"},
+    {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+     "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+     "5bc94fbc3221a5db94fae95ae7121a47"},
+    {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbad",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+     "61353b4c2806934a777ff51fa22a4755699b2a714fcdc6f83766e5f97b6c742373806900e49f24b22b097544d4896b424989b5e1ebac0f07c23f4598",
+     "3612d2e79e3b0785561be14aaca2fccb"},
+    {"feffe9928665731c6d6a8f9467308308",
+     "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+     "8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+     "619cc5aefffe0bfa462af43c1699d050"},
+};
+
+// Function to decode a hex string, returning the number of bytes
+int hex_decode(const char *hex, unsigned char *out) {
+    int len = strlen(hex) / 2;
+    for (int i = 0; i < len; ++i) {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        out[i] = (unsigned char)byte;
+    }
+    return len;
+}
+
+// Function to run the GCM test vectors with the given GHASH implementation,
+// feeding the data in uneven pieces to exercise the streaming interface.
+// Returns the number of failures.
+int gcm_self_test(int use_clmul) {
+    int failures = 0;
+    for (size_t t = 0; t < sizeof(gcm_tests) / sizeof(gcm_tests[0]); ++t) {
+        unsigned char key[16], iv[64], plaintext[64], aad[32], expected[64], tag[16];
+        unsigned char output[64], computed[16];
+        hex_decode(gcm_tests[t].key, key);
+        int iv_len = hex_decode(gcm_tests[t].iv, iv);
+        int len = hex_decode(gcm_tests[t].plaintext, plaintext);
+        int aad_len = hex_decode(gcm_tests[t].aad, aad);
+        hex_decode(gcm_tests[t].ciphertext, expected);
+        hex_decode(gcm_tests[t].tag, tag);
+
+        aes128_cipher aes(key, AES_ENCRYPT_ONLY);
+        gcm_key<aes128_cipher> gkey;
+        gcm_context<aes128_cipher> ctx;
+        gcm_key_init(&gkey, aes);
+        gkey.ghash.use_clmul &= use_clmul;
+
+        gcm_start(&ctx, &gkey, iv, iv_len);
+        for (int i = 0; i < aad_len; i += 7) {
+            gcm_aad(&ctx, aad + i, aad_len - i < 7 ? aad_len - i : 7);
+        }
+        for (int i = 0; i < len; i += 21) {
+            gcm_encrypt(&ctx, plaintext + i, output + i, len - i < 21 ? len - i : 21);
+        }
+        gcm_finish(&ctx, computed, GCM_TAG_SIZE);
+        int ok = memcmp(output, expected, len) == 0 && memcmp(computed, tag, GCM_TAG_SIZE) == 0;
+
+        gcm_start(&ctx, &gkey, iv, iv_len);
+        gcm_aad(&ctx, aad, aad_len);
+        gcm_decrypt(&ctx, output, output, len);
+        ok = ok && gcm_check(&ctx, tag, GCM_TAG_SIZE) == 0 && memcmp(output, plaintext, len) == 0;
+
+        if (!ok) {
+            printf("GCM test case %d failed\n", (int)t + 1);
+            failures++;
+        }
+    }
+    return failures;
 }
 
 int main() {
@@ -103,6 +205,39 @@ int main() {
     decryptedtext[AES_BLOCK_SIZE] = '\0';
     printf("CFB decrypted: %s\n", decryptedtext);
 
+    // GCM mode
+    unsigned char gcm_iv[12] = "abcdefghijk";
+    unsigned char aad[] = "record header";
+    unsigned char gcm_ciphertext[sizeof(plaintext)];
+    unsigned char tag[GCM_TAG_SIZE];
+    int aad_len = strlen((char *)aad);
+
+    aes_gcm_encrypt(plaintext, plaintext_len, aad, aad_len, key, gcm_iv, sizeof(gcm_iv), gcm_ciphertext, tag);
+    printf("GCM encrypted: ");
+    for (int i = 0; i < plaintext_len; ++i) {
+        printf("%02x", gcm_ciphertext[i]);
+    }
+    printf("\nGCM tag: ");
+    for (int i = 0; i < GCM_TAG_SIZE; ++i) {
+        printf("%02x", tag[i]);
+    }
+    printf("\n");
+
+    if (aes_gcm_decrypt(gcm_ciphertext, plaintext_len, aad, aad_len, key, gcm_iv, sizeof(gcm_iv), tag, decryptedtext) == 0) {
+        decryptedtext[plaintext_len] = '\0';
+        printf("GCM decrypted: %s\n", decryptedtext);
+    }
+    gcm_ciphertext[0] ^= 1;
+    if (aes_gcm_decrypt(gcm_ciphertext, plaintext_len, aad, aad_len, key, gcm_iv, sizeof(gcm_iv), tag, decryptedtext) != 0) {
+        printf("GCM rejected a modified ciphertext\n");
+    }
+
+    int failures = gcm_self_test(0);
+    printf("GCM test vectors (4-bit tables): %s\n", failures ? "FAILED" : "passed");
+    failures = gcm_self_test(1);
+    printf("GCM test vectors (PCLMULQDQ when available): %s\n", failures ? "FAILED" : "passed");
+
+    PERF_REPORT(stdout);
 return 0 ;
 
 }
@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-// S-DES key length and block size
+#include "block_modes.h"
+
+// S-DES key length and block size in bits
 #define SDES_KEY_SIZE 10
 #define SDES_BLOCK_SIZE 8
 
@@ -39,131 +43,183 @@ const uint8_t ep[8] = {3, 0, 1, 2, 1, 2, 3, 0};
 // Straight permutation P4
 const uint8_t p4[4] = {1, 3, 2, 0};
 
-// Function prototypes
-void sdes_key_schedule(const uint8_t *key, uint8_t *k1, uint8_t *k2);
-void sdes_encrypt(const uint8_t *plaintext, const uint8_t *key, const uint8_t *iv, uint8_t *ciphertext);
-void sdes_decrypt(const uint8_t *ciphertext, const uint8_t *key, const uint8_t *iv, uint8_t *plaintext);
-void initial_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm);
-void inverse_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm);
-void permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm, int size);
-void expansion_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm, int size);
-void sbox(const uint8_t *input, uint8_t *output, const uint8_t sbox[4][4], int size);
-void xor_bits(uint8_t *result, const uint8_t *a, const uint8_t *b, int size);
-
-// S-DES key schedule
-void sdes_key_schedule(const uint8_t *key, uint8_t *k1, uint8_t *k2) {
-    uint8_t temp_key[10];
-    permutation(key, temp_key, p10, 10);
-    
-    // Left circular shift (LS-1)
-    uint8_t temp = temp_key[0];
-    for (int i = 0; i < 4; i++) {
-        temp_key[i] = temp_key[i + 1];
+// Every block of a key encrypted and decrypted ahead of time. S-DES has only
+// 256 possible blocks, so after building this once per key each block is a
+// single table load.
+typedef struct {
+    uint8_t enc[256];
+    uint8_t dec[256];
+} sdes_codebook;
+
+// Codebook backend for the block_modes.h templates
+struct sdes_cipher {
+    static constexpr size_t block_size = 1;
+    static constexpr int perf_id = PERF_SDES;
+    const sdes_codebook *codebook;
+
+    void encrypt_block(const uint8_t *in, uint8_t *out) const {
+        *out = codebook->enc[*in];
     }
-    temp_key[4] = temp;
 
-    // Generate K1
-    permutation(temp_key, k1, p8, 8);
-
-    // Left circular shift (LS-2)
-    temp = temp_key[5];
-    temp_key[5] = temp_key[6];
-    temp_key[6] = temp;
-    temp = temp_key[7];
-    temp_key[7] = temp_key[8];
-    temp_key[8] = temp;
+    void decrypt_block(const uint8_t *in, uint8_t *out) const {
+        *out = codebook->dec[*in];
+    }
+};
 
-    // Generate K2
-    permutation(temp_key, k2, p8, 8);
+// Function prototypes
+uint16_t permutation(uint16_t input, const uint8_t *perm, int in_size, int out_size);
+void sdes_key_schedule(uint16_t key, uint8_t *k1, uint8_t *k2);
+uint8_t sdes_round(uint8_t block, uint8_t subkey);
+uint8_t sdes_encrypt(uint8_t plaintext, uint8_t k1, uint8_t k2);
+uint8_t sdes_decrypt(uint8_t ciphertext, uint8_t k1, uint8_t k2);
+void sdes_build_codebook(uint16_t key, sdes_codebook *codebook);
+void sdes_cbc_encrypt(const sdes_codebook *codebook, uint8_t *iv, const uint8_t *plaintext, uint8_t *ciphertext, size_t len);
+void sdes_cbc_decrypt(const sdes_codebook *codebook, uint8_t *iv, const uint8_t *ciphertext, uint8_t *plaintext, size_t len);
+
+// General permutation on packed bits: output bit i (counting from the most
+// significant) is input bit perm[i]
+uint16_t permutation(uint16_t input, const uint8_t *perm, int in_size, int out_size) {
+    uint16_t output = 0;
+    for (int i = 0; i < out_size; i++) {
+        output = (output << 1) | ((input >> (in_size - 1 - perm[i])) & 1);
+    }
+    return output;
 }
 
-// S-DES encryption
-void sdes_encrypt(const uint8_t *plaintext, const uint8_t *key, const uint8_t *iv, uint8_t *ciphertext) {
-    uint8_t k1[8], k2[8];
-    uint8_t temp[SDES_BLOCK_SIZE], temp2[SDES_BLOCK_SIZE];
-
-    // Generate subkeys
-    sdes_key_schedule(key, k1, k2);
-
-    // Initial permutation (IP)
-    initial_permutation(plaintext, temp, ip);
-
-    // XOR with IV for CBC mode
-    xor_bits(temp, temp, iv, SDES_BLOCK_SIZE);
-
-    // Round 1: Fk1
-    expansion_permutation(temp, temp2, ep, 8);
-    xor_bits(temp2, temp2, k1, 8);
-    sbox(temp2, temp, sbox0, 4);
-    permutation(temp, temp, p4, 4);
-    xor_bits(temp, temp, &temp2[4], 4);
-
-    // Round 2: Fk2
-    expansion_permutation(temp, temp2, ep, 8);
-    xor_bits(temp2, temp2, k2, 8);
-    sbox(temp2, temp, sbox1, 4);
-    permutation(temp, temp, p4, 4);
-    xor_bits(temp, temp, &temp2[4], 4);
+// Rotate a 5-bit half left
+static uint16_t rotate5(uint16_t half, int shift) {
+    return ((half << shift) | (half >> (5 - shift))) & 0x1F;
+}
 
-    // Final permutation (IP^-1)
-    inverse_permutation(temp, ciphertext, ip_inv);
+// S-DES key schedule
+void sdes_key_schedule(uint16_t key, uint8_t *k1, uint8_t *k2) {
+    PERF_KEY_SETUP(PERF_SDES, 1);
+    uint16_t temp_key = permutation(key, p10, 10, 10);
+    uint16_t left = temp_key >> 5, right = temp_key & 0x1F;
+
+    // Left circular shift (LS-1), then generate K1
+    left = rotate5(left, 1);
+    right = rotate5(right, 1);
+    *k1 = (uint8_t)permutation((left << 5) | right, p8, 10, 8);
+
+    // Left circular shift (LS-2), then generate K2
+    left = rotate5(left, 2);
+    right = rotate5(right, 2);
+    *k2 = (uint8_t)permutation((left << 5) | right, p8, 10, 8);
 }
 
-// S-DES decryption
-void sdes_decrypt(const uint8_t *ciphertext, const uint8_t *key, const uint8_t *iv, uint8_t *plaintext) {
-    uint8_t k1[8], k2[8];
-    uint8_t temp[SDES_BLOCK_SIZE], temp2[SDES_BLOCK_SIZE];
+// One Feistel round fK: the left nibble is XORed with F(right, subkey)
+uint8_t sdes_round(uint8_t block, uint8_t subkey) {
+    uint8_t right = block & 0x0F;
+    uint8_t x = (uint8_t)permutation(right, ep, 4, 8) ^ subkey;
 
-    // Generate subkeys
-    sdes_key_schedule(key, k1, k2);
+    // S-boxes: row from the outer bits, column from the inner bits
+    uint8_t s0 = sbox0[((x >> 6) & 2) | ((x >> 4) & 1)][(x >> 5) & 3];
+    uint8_t s1 = sbox1[((x >> 2) & 2) | (x & 1)][(x >> 1) & 3];
+    uint8_t f = (uint8_t)permutation((s0 << 2) | s1, p4, 4, 4);
 
-    // Initial permutation (IP)
-    initial_permutation(ciphertext, temp, ip);
+    return block ^ (f << 4);
+}
 
-    // Round 1: Fk2
-    expansion_permutation(temp, temp2, ep, 8);
-    xor_bits(temp2, temp2, k2, 8);
-    sbox(temp2, temp, sbox1, 4);
-    permutation(temp, temp, p4, 4);
-    xor_bits(temp, temp, &temp2[4], 4);
+// S-DES encryption of one packed block
+uint8_t sdes_encrypt(uint8_t plaintext, uint8_t k1, uint8_t k2) {
+    PERF_SCOPE(PERF_SDES, PERF_MODE_BLOCK, 1, 1);
+    uint8_t temp = (uint8_t)permutation(plaintext, ip, 8, 8);
+    temp = sdes_round(temp, k1);
+    temp = (uint8_t)((temp << 4) | (temp >> 4));   // Switch the halves
+    temp = sdes_round(temp, k2);
+    return (uint8_t)permutation(temp, ip_inv, 8, 8);
+}
 
-    // Round 2: Fk1
-    expansion_permutation(temp, temp2, ep, 8);
-    xor_bits(temp2, temp2, k1, 8);
-    sbox(temp2, temp, sbox0, 4);
-    permutation(temp, temp, p4, 4);
-    xor_bits(temp, temp, &temp2[4], 4);
+// S-DES decryption of one packed block
+uint8_t sdes_decrypt(uint8_t ciphertext, uint8_t k1, uint8_t k2) {
+    return sdes_encrypt(ciphertext, k2, k1);
+}
 
-    // Final permutation (IP^-1)
-    inverse_permutation(temp, plaintext, ip_inv);
+// Build the encrypt and decrypt codebooks for one key
+void sdes_build_codebook(uint16_t key, sdes_codebook *codebook) {
+    uint8_t k1, k2;
+    sdes_key_schedule(key, &k1, &k2);
 
-    // XOR with IV for CBC mode
-    xor_bits(plaintext, plaintext, iv, SDES_BLOCK_SIZE);
+    for (int p = 0; p < 256; p++) {
+        uint8_t c = sdes_encrypt((uint8_t)p, k1, k2);
+        codebook->enc[p] = c;
+        codebook->dec[c] = (uint8_t)p;
+    }
 }
 
-// Initial permutation
-void initial_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm) {
-    permutation(input, output, perm, 8);
+// S-DES in CBC mode: one table load and one XOR per byte
+void sdes_cbc_encrypt(const sdes_codebook *codebook, uint8_t *iv, const uint8_t *plaintext, uint8_t *ciphertext, size_t len) {
+    sdes_cipher sdes = { codebook };
+    cbc_encrypt(sdes, iv, plaintext, ciphertext, len);
 }
 
-// Inverse initial permutation
-void inverse_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm) {
-    permutation(input, output, perm, 8);
+void sdes_cbc_decrypt(const sdes_codebook *codebook, uint8_t *iv, const uint8_t *ciphertext, uint8_t *plaintext, size_t len) {
+    sdes_cipher sdes = { codebook };
+    cbc_decrypt(sdes, iv, ciphertext, plaintext, len);
 }
 
-// General permutation function
-void permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm, int size) {
-    for (int i = 0; i < size; i++) {
-        output[i] = (input[(perm[i] / 8)] >> (7 - (perm[i] % 8))) & 1;
-    }
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-// Expansion permutation (E/P)
-void expansion_permutation(const uint8_t *input, uint8_t *output, const uint8_t *perm, int size) {
-    for (int i = 0; i < size; i++) {
-        output[i] = input[perm[i]];
+int main() {
+    // Textbook example: key 1010000010, plaintext 10010111 -> ciphertext 00111000
+    uint16_t key = 0x282;
+    uint8_t k1, k2;
+    sdes_key_schedule(key, &k1, &k2);
+    uint8_t block = sdes_encrypt(0x97, k1, k2);
+    printf("K1 = %02x, K2 = %02x\n", k1, k2);
+    printf("Encrypt 97 -> %02x, decrypt back -> %02x\n", block, sdes_decrypt(block, k1, k2));
+
+    sdes_codebook codebook;
+    sdes_build_codebook(key, &codebook);
+
+    // CBC over a small message
+    const char message[] = "S-DES in CBC mode";
+    size_t length = strlen(message);
+    uint8_t ciphertext[sizeof(message)], decrypted[sizeof(message)];
+    uint8_t iv = 0xAA;
+    sdes_cbc_encrypt(&codebook, &iv, (const uint8_t *)message, ciphertext, length);
+    iv = 0xAA;
+    sdes_cbc_decrypt(&codebook, &iv, ciphertext, decrypted, length);
+    decrypted[length] = '\0';
+
+    printf("CBC ciphertext: ");
+    for (size_t i = 0; i < length; i++) {
+        printf("%02x", ciphertext[i]);
+    }
+    printf("\nCBC decrypted: %s\n", decrypted);
+
+    // Bulk CBC throughput
+    size_t bulk = 64 << 20;
+    uint8_t *in = (uint8_t *)malloc(bulk);
+    uint8_t *out = (uint8_t *)malloc(bulk);
+    if (in == NULL || out == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < bulk; i++) {
+        in[i] = (uint8_t)(i * 131);
     }
-}
 
-// S-box substitution
+    double start = now_seconds();
+    iv = 0xAA;
+    sdes_cbc_encrypt(&codebook, &iv, in, out, bulk);
+    double encrypt_time = now_seconds() - start;
 
+    start = now_seconds();
+    iv = 0xAA;
+    sdes_cbc_decrypt(&codebook, &iv, out, out, bulk);
+    double decrypt_time = now_seconds() - start;
+
+    printf("CBC on %zu MiB: encrypt %.0f MB/s, decrypt %.0f MB/s, round trip %s\n", bulk >> 20,
+           bulk / encrypt_time / 1e6, bulk / decrypt_time / 1e6, memcmp(in, out, bulk) == 0 ? "ok" : "FAILED");
+
+    free(in);
+    free(out);
+    PERF_REPORT(stdout);
+    return 0;
+}
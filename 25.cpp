@@ -1,45 +1,68 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <gmp.h>>
+#include <gmp.h>
 
-// Function to perform RSA decryption
-void rsa_decrypt(mpz_t m, const mpz_t c, const mpz_t p, const mpz_t q, const mpz_t e) {
+#include "gmp_pool.h"
+
+// Modulus size used to presize the allocator pools and the workspace
+#define RSA_MODULUS_BITS 128
+
+// Preallocated temporaries for rsa_decrypt, reused across calls
+typedef struct {
     mpz_t n, d, phi_n;
+    mpz_t p1, q1;
+} rsa_workspace;
 
+void rsa_workspace_init(rsa_workspace *ws, unsigned long bits) {
+    mpz_init2(ws->n, bits);
+    mpz_init2(ws->d, bits);
+    mpz_init2(ws->phi_n, bits);
+    mpz_init2(ws->p1, bits);
+    mpz_init2(ws->q1, bits);
+}
+
+void rsa_workspace_clear(rsa_workspace *ws) {
+    mpz_clear(ws->n);
+    mpz_clear(ws->d);
+    mpz_clear(ws->phi_n);
+    mpz_clear(ws->p1);
+    mpz_clear(ws->q1);
+}
+
+// Function to perform RSA decryption
+void rsa_decrypt(mpz_t m, const mpz_t c, const mpz_t p, const mpz_t q, const mpz_t e, rsa_workspace *ws) {
     // Calculate n = p * q
-    mpz_init(n);
-    mpz_mul(n, p, q);
+    mpz_mul(ws->n, p, q);
 
     // Calculate phi(n) = (p-1)(q-1)
-    mpz_init(phi_n);
-    mpz_sub_ui(p, p, 1); // p = p - 1
-    mpz_sub_ui(q, q, 1); // q = q - 1
-    mpz_mul(phi_n, p, q);
+    mpz_sub_ui(ws->p1, p, 1);
+    mpz_sub_ui(ws->q1, q, 1);
+    mpz_mul(ws->phi_n, ws->p1, ws->q1);
 
     // Compute d such that e * d = 1 (mod phi(n))
-    mpz_init(d);
-    mpz_invert(d, e, phi_n);
+    mpz_invert(ws->d, e, ws->phi_n);
 
     // Decrypt ciphertext c: m = c^d (mod n)
-    mpz_init(m);
-    mpz_powm(m, c, d, n);
+    mpz_powm(m, c, ws->d, ws->n);
 
-    // Clean up
-    mpz_clear(n);
-    mpz_clear(d);
-    mpz_clear(phi_n);
+    gmp_pool_count_op();
 }
 
 int main() {
     mpz_t p, q, e, c, m;
+    rsa_workspace ws;
+
+    // Route GMP through the pooled allocator before any variable is created
+    gmp_pool_init(RSA_MODULUS_BITS);
 
     // Initialize variables
     mpz_init(p);
     mpz_init(q);
     mpz_init(e);
     mpz_init(c);
-    mpz_init(m);
+    mpz_init2(m, RSA_MODULUS_BITS);
+    rsa_workspace_init(&ws, RSA_MODULUS_BITS);
 
     // Set values for p, q, e, and c (ciphertext)
     mpz_set_str(p, "1234567890123456789", 10); // Replace with actual value of p
@@ -47,8 +70,10 @@ int main() {
     mpz_set_str(e, "65537", 10); // Replace with actual value of public exponent e
     mpz_set_str(c, "1234567890123456789", 10); // Replace with actual value of ciphertext c
 
-    // Perform RSA decryption
-    rsa_decrypt(m, c, p, q, e);
+    // Perform RSA decryption, counting only its allocations
+    gmp_pool_stats start = gmp_pool_get_stats();
+    rsa_decrypt(m, c, p, q, e, &ws);
+    gmp_pool_stats steady = gmp_pool_stats_since(&start);
 
     // Print the plaintext m
     gmp_printf("Decrypted plaintext m: %Zd\n", m);
@@ -59,6 +84,9 @@ int main() {
     mpz_clear(e);
     mpz_clear(c);
     mpz_clear(m);
+    rsa_workspace_clear(&ws);
+
+    gmp_pool_print_stats(&steady);
 
 return0;
 }
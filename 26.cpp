@@ -3,6 +3,24 @@
 #include <string.h>
 #include <gmp.h>
 
+#include "gmp_pool.h"
+
+// Modulus size used to presize the allocator pools and the workspace
+#define RSA_MODULUS_BITS 1024
+
+// Preallocated temporary for rsa_encrypt and rsa_decrypt, reused across calls
+typedef struct {
+    mpz_t m;
+} rsa_workspace;
+
+void rsa_workspace_init(rsa_workspace *ws, unsigned long bits) {
+    mpz_init2(ws->m, bits);
+}
+
+void rsa_workspace_clear(rsa_workspace *ws) {
+    mpz_clear(ws->m);
+}
+
 // Function to generate RSA key pair
 void generate_rsa_keypair(mpz_t n, mpz_t e, mpz_t d, mpz_t p, mpz_t q) {
     mpz_t phi_n, gcd;
@@ -38,39 +56,35 @@ void generate_rsa_keypair(mpz_t n, mpz_t e, mpz_t d, mpz_t p, mpz_t q) {
 }
 
 // Function to encrypt message m with RSA public key (n, e)
-void rsa_encrypt(mpz_t ciphertext, const char *plaintext, const mpz_t n, const mpz_t e) {
-    mpz_t m;
-    mpz_init(m);
-
+void rsa_encrypt(mpz_t ciphertext, const char *plaintext, const mpz_t n, const mpz_t e, rsa_workspace *ws) {
     // Convert plaintext to a GMP integer
-    mpz_set_str(m, plaintext, 10); // Convert plaintext to mpz_t (base 10)
+    mpz_set_str(ws->m, plaintext, 10); // Convert plaintext to mpz_t (base 10)
 
     // Encrypt: ciphertext = m^e % n
-    mpz_powm(ciphertext, m, e, n);
+    mpz_powm(ciphertext, ws->m, e, n);
 
-    // Clean up
-    mpz_clear(m);
+    gmp_pool_count_op();
 }
 
 // Function to decrypt ciphertext with RSA private key (n, d)
-void rsa_decrypt(char *plaintext, const mpz_t ciphertext, const mpz_t n, const mpz_t d) {
-    mpz_t decrypted;
-    mpz_init(decrypted);
-
+void rsa_decrypt(char *plaintext, const mpz_t ciphertext, const mpz_t n, const mpz_t d, rsa_workspace *ws) {
     // Decrypt: decrypted = ciphertext^d % n
-    mpz_powm(decrypted, ciphertext, d, n);
+    mpz_powm(ws->m, ciphertext, d, n);
 
     // Convert decrypted result back to string
-    mpz_get_str(plaintext, 10, decrypted);
+    mpz_get_str(plaintext, 10, ws->m);
 
-    // Clean up
-    mpz_clear(decrypted);
+    gmp_pool_count_op();
 }
 
 int main() {
     // Declare variables
     mpz_t n, e, d, p, q, ciphertext;
     char plaintext[1024] = "Hello, RSA!"; // Plain text message to encrypt
+    rsa_workspace ws;
+
+    // Route GMP through the pooled allocator before any variable is created
+    gmp_pool_init(RSA_MODULUS_BITS);
 
     // Initialize GMP variables
     mpz_init(n);
@@ -78,21 +92,23 @@ int main() {
     mpz_init(d);
     mpz_init(p);
     mpz_init(q);
-    mpz_init(ciphertext);
+    mpz_init2(ciphertext, RSA_MODULUS_BITS);
+    rsa_workspace_init(&ws, RSA_MODULUS_BITS);
 
     // Generate RSA key pair
     generate_rsa_keypair(n, e, d, p, q);
 
-    // Encrypt the plaintext message
-    rsa_encrypt(ciphertext, plaintext, n, e);
+    // Encrypt the plaintext message and decrypt it again, counting only the
+    // allocations of the two RSA operations
+    char decrypted_plaintext[1024];
+    gmp_pool_stats start = gmp_pool_get_stats();
+    rsa_encrypt(ciphertext, plaintext, n, e, &ws);
+    rsa_decrypt(decrypted_plaintext, ciphertext, n, d, &ws);
+    gmp_pool_stats steady = gmp_pool_stats_since(&start);
 
     // Print the ciphertext (as a large integer)
     gmp_printf("Ciphertext (as a large integer): %Zd\n", ciphertext);
 
-    // Decrypt the ciphertext
-    char decrypted_plaintext[1024];
-    rsa_decrypt(decrypted_plaintext, ciphertext, n, d);
-
     // Print the decrypted plaintext
     printf("Decrypted plaintext: %s\n", decrypted_plaintext);
 
@@ -103,6 +119,9 @@ int main() {
     mpz_clear(p);
     mpz_clear(q);
     mpz_clear(ciphertext);
+    rsa_workspace_clear(&ws);
+
+    gmp_pool_print_stats(&steady);
 
 return0;
 }
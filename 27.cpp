@@ -3,22 +3,27 @@
 #include <string.h>
 #include <gmp.h>
 
-// Function to encrypt a single character using RSA
-void rsa_encrypt_char(mpz_t ciphertext, int plaintext_char, const mpz_t n, const mpz_t e) {
-    mpz_t m;
-    mpz_init(m);
+#include "gmp_pool.h"
 
+// Modulus size used to presize the allocator pools and the workspace
+#define RSA_MODULUS_BITS 2048
+
+// Function to encrypt a single character using RSA. m is a workspace owned
+// by the caller and reused for every character instead of being reallocated.
+void rsa_encrypt_char(mpz_t ciphertext, mpz_t m, int plaintext_char, const mpz_t n, const mpz_t e) {
     // Convert character to integer (0 to 25)
     mpz_set_ui(m, plaintext_char);
 
     // Encrypt: ciphertext = m^e % n
     mpz_powm(ciphertext, m, e, n);
 
-    // Clean up
-    mpz_clear(m);
+    gmp_pool_count_op();
 }
 
 int main() {
+    // Route GMP through the pooled allocator before any variable is created
+    gmp_pool_init(RSA_MODULUS_BITS);
+
     // RSA parameters
     mpz_t n, e;
     mpz_init(n);
@@ -29,25 +34,32 @@ int main() {
     // Plaintext message as a string
     char plaintext[] = "HELLO";
 
-    // Initialize GMP variable for ciphertext
-    mpz_t ciphertext;
-    mpz_init(ciphertext);
+    // Initialize GMP variables for the ciphertext and the message workspace
+    mpz_t ciphertext, m;
+    mpz_init2(ciphertext, RSA_MODULUS_BITS);
+    mpz_init2(m, RSA_MODULUS_BITS);
 
-    // Encrypt each character in the plaintext
+    // Encrypt each character in the plaintext, counting only the
+    // allocations made inside the loop
+    gmp_pool_stats start = gmp_pool_get_stats();
     for (int i = 0; i < strlen(plaintext); i++) {
         // Convert character to corresponding integer (0 to 25)
         int plaintext_char = plaintext[i] - 'A';
 
         // Encrypt the character
-        rsa_encrypt_char(ciphertext, plaintext_char, n, e);
+        rsa_encrypt_char(ciphertext, m, plaintext_char, n, e);
 
         // Print or use ciphertext here (not shown for simplicity)
     }
+    gmp_pool_stats steady = gmp_pool_stats_since(&start);
 
     // Clean up GMP variables
     mpz_clear(n);
     mpz_clear(e);
     mpz_clear(ciphertext);
+    mpz_clear(m);
+
+    gmp_pool_print_stats(&steady);
 
 return0;
 }
@@ -1,108 +1,98 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
-#define KECCAK_ROUNDS 24
-#define STATE_SIZE 1600 // State size in bits for SHA-3-1024
-
-typedef struct {
-    uint64_t A[5][5]; // State matrix A
-    uint64_t capacity[2]; // Capacity part (512 bits)
-    uint64_t rate[16]; // Rate part (1024 bits - 512 bits for capacity)
-    int rate_position; // Position in the rate part
-} sha3_1024_ctx;
-
-// Rotation function
-#define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
-
-// Keccak round constants
-const uint64_t keccak_rc[24] = {
-    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
-    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
-    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
-    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
-    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
-    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
-};
-
-// Function to initialize SHA-3 context
-void sha3_1024_init(sha3_1024_ctx *ctx) {
-    memset(ctx, 0, sizeof(sha3_1024_ctx));
-}
-
-// Function to absorb a single message block (1024 bits) into the state
-void sha3_1024_absorb(sha3_1024_ctx *ctx, const uint64_t *block) {
-    int i;
+#include "keccak.h"
 
-    // XOR the block into the rate part
-    for (i = 0; i < 16; i++) {
-        ctx->rate[i] ^= block[i];
+// Function to print a labelled hex string
+void print_hex(const char *label, const uint8_t *data, size_t len) {
+    printf("%s", label);
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", data[i]);
     }
+    printf("\n");
+}
 
-    // Perform Keccak-f[1600] permutation
-    keccak_permutation(ctx->A);
+// Function to decode a hex string, returning the number of bytes
+size_t hex_decode(const char *hex, uint8_t *out) {
+    size_t len = strlen(hex) / 2;
+    for (size_t i = 0; i < len; i++) {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        out[i] = (uint8_t)byte;
+    }
+    return len;
 }
 
-// Keccak-f[1600] permutation function
-void keccak_permutation(uint64_t A[5][5]) {
-    int round, i, j, k;
-    uint64_t C[5], D[5], B[5][5];
+// Function to check a MAC against its expected hex value
+int check_mac(const char *name, const uint8_t *mac, size_t len, const char *expected_hex) {
+    uint8_t expected[64];
+    size_t expected_len = hex_decode(expected_hex, expected);
+    int ok = expected_len == len && memcmp(mac, expected, len) == 0;
+    printf("%s: %s\n", name, ok ? "passed" : "FAILED");
+    return ok;
+}
 
-    for (round = 0; round < KECCAK_ROUNDS; round++) {
-        // ? step
-        for (i = 0; i < 5; i++) {
-            C[i] = A[i][0] ^ A[i][1] ^ A[i][2] ^ A[i][3] ^ A[i][4];
-        }
-        for (i = 0; i < 5; i++) {
-            D[i] = C[(i + 4) % 5] ^ ROTL64(C[(i + 1) % 5], 1);
-        }
-        for (i = 0; i < 5; i++) {
-            for (j = 0; j < 5; j++) {
-                A[i][j] ^= D[i];
-            }
+// Function to compare MACs per message, MACs from the keyed state, and the
+// batch API on many short messages under one key
+void benchmark(void) {
+    enum { MESSAGES = 4096, MESSAGE_LEN = 64, ROUNDS = 50 };
+    static uint8_t messages[MESSAGES][MESSAGE_LEN];
+    static uint8_t macs[MESSAGES * 32];
+    const uint8_t *ptrs[MESSAGES];
+    size_t lens[MESSAGES];
+    uint8_t key[32];
+    kmac_key k;
+
+    for (int i = 0; i < 32; i++) {
+        key[i] = (uint8_t)(0x40 + i);
+    }
+    for (int i = 0; i < MESSAGES; i++) {
+        for (int j = 0; j < MESSAGE_LEN; j++) {
+            messages[i][j] = (uint8_t)(i * 31 + j);
         }
+        ptrs[i] = messages[i];
+        lens[i] = MESSAGE_LEN;
+    }
 
-        // ? and p steps
-        for (i = 0; i < 5; i++) {
-            for (j = 0; j < 5; j++) {
-                B[j][(2 * i + 3 * j) % 5] = ROTL64(A[i][j], (j + 1) * (i + 1));
-            }
+    clock_t start = clock();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < MESSAGES; i++) {
+            kmac_key_init(&k, 128, key, sizeof(key), NULL, 0);
+            kmac(&k, messages[i], MESSAGE_LEN, macs + i * 32, 32);
         }
+    }
+    double rekeyed = (double)(clock() - start) / CLOCKS_PER_SEC;
 
-        // ? step
-        for (i = 0; i < 5; i++) {
-            for (j = 0; j < 5; j++) {
-                A[i][j] = B[i][j] ^ ((~B[(i + 1) % 5][j]) & B[(i + 2) % 5][j]);
-            }
+    kmac_key_init(&k, 128, key, sizeof(key), NULL, 0);
+    start = clock();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < MESSAGES; i++) {
+            kmac(&k, messages[i], MESSAGE_LEN, macs + i * 32, 32);
         }
-
-        // ? step
-        A[0][0] ^= keccak_rc[round];
     }
-}
+    double keyed = (double)(clock() - start) / CLOCKS_PER_SEC;
 
-// Function to finalize SHA-3 and produce the hash output
-void sha3_1024_finalize(sha3_1024_ctx *ctx, uint8_t *hash) {
-    // XOR the last block and padding bits into the rate part
-    ctx->rate[ctx->rate_position] ^= 0x06; // Append 0x06 for SHA-3-1024
-    ctx->rate[15] ^= 0x8000000000000000ULL; // Append 0x8000000000000000
-
-    // Perform final Keccak-f[1600] permutation
-    keccak_permutation(ctx->A);
+    start = clock();
+    for (int r = 0; r < ROUNDS; r++) {
+        kmac_batch(&k, ptrs, lens, MESSAGES, macs, 32);
+    }
+    double batched = (double)(clock() - start) / CLOCKS_PER_SEC;
 
-    // Extract the hash output from the state matrix (capacity part)
-    memcpy(hash, ctx->capacity, 64); // 64 bytes for SHA-3-1024 output
+    double total = (double)MESSAGES * ROUNDS;
+    printf("KMAC128 of %d-byte messages:\n", MESSAGE_LEN);
+    printf("  key absorbed per message: %.0f MACs/s\n", total / rekeyed);
+    printf("  precomputed keyed state:  %.0f MACs/s\n", total / keyed);
+    printf("  batch, %d lanes:           %.0f MACs/s\n", KECCAK_LANES, total / batched);
 }
 
 int main() {
-    sha3_1024_ctx ctx;
-    uint8_t hash[128]; // SHA-3-1024 produces 128-byte hash output (1024 bits)
-
-    // Initialize SHA-3 context
-    sha3_1024_init(&ctx);
+    uint8_t hash[64];
+    uint8_t mac[64];
 
-    // Example message (1024-bit block)
-    uint64_t message[16] = {
+    // Example message: the sixteen 64-bit words of the original demo
+    const uint64_t words[16] = {
         0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL,
         0x123456789ABCDEF0ULL, 0xFEDCBA9876543210ULL,
         0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL,
@@ -112,20 +102,82 @@ int main() {
         0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL,
         0x123456789ABCDEF0ULL, 0xFEDCBA9876543210ULL
     };
+    uint8_t message[128];
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 8; j++) {
+            message[8 * i + j] = (uint8_t)(words[i] >> (8 * j));
+        }
+    }
 
-    // Absorb the message block
-    sha3_1024_absorb(&ctx, message);
+    sha3(message, sizeof(message), hash, 64);
+    print_hex("SHA3-512 Hash: ", hash, 64);
 
-    // Finalize and get the hash output
-    sha3_1024_finalize(&ctx, hash);
+    sha3((const uint8_t *)"abc", 3, hash, 32);
+    check_mac("SHA3-256(\"abc\")", hash, 32, "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532");
 
-    // Print the hash output
-    printf("SHA3-1024 Hash: ");
-    for (int i = 0; i < 128; i++) {
-        printf("%02x", hash[i]);
+    // KMAC samples from NIST SP 800-185
+    uint8_t key[32], data[200];
+    const char *tag = "My Tagged Application";
+    for (int i = 0; i < 32; i++) {
+        key[i] = (uint8_t)(0x40 + i);
     }
-    printf("\n");
+    for (int i = 0; i < 200; i++) {
+        data[i] = (uint8_t)i;
+    }
+    kmac_key k;
+    kmac_key_init(&k, 128, key, sizeof(key), NULL, 0);
+    kmac(&k, data, 4, mac, 32);
+    check_mac("KMAC128 sample 1", mac, 32, "e5780b0d3ea6f7d3a429c5706aa43a00fadbd7d49628839e3187243f456ee14e");
+
+    kmac_key_init(&k, 128, key, sizeof(key), (const uint8_t *)tag, strlen(tag));
+    kmac(&k, data, 4, mac, 32);
+    check_mac("KMAC128 sample 2", mac, 32, "3b1fba963cd8b0b59e8c1a6d71888b7143651af8ba0a7070c0979e2811324aa5");
+
+    kmac(&k, data, 200, mac, 32);
+    check_mac("KMAC128 sample 3", mac, 32, "1f5b4e6cca02209e0dcb5ca635b89a15e271ecc760071dfd805faa38f9729230");
+
+    kmac_key_init(&k, 256, key, sizeof(key), (const uint8_t *)tag, strlen(tag));
+    kmac(&k, data, 4, mac, 64);
+    check_mac("KMAC256 sample 4", mac, 64,
+              "20c570c31346f703c9ac36c61c03cb64c3970d0cfc787e9b79599d273a68d2f7"
+              "f69d4cc3de9d104a351689f27cf6f5951f0103f33f4f24871024d9c27773a8dd");
+
+    // HMAC-SHA3-256 of the key 0x00..0x1f over "Sample message for keylen<blocklen"
+    // (NIST HMAC-SHA3 example values)
+    const char *sample = "Sample message for keylen<blocklen";
+    uint8_t hmac_key[32];
+    for (int i = 0; i < 32; i++) {
+        hmac_key[i] = (uint8_t)i;
+    }
+    hmac_sha3_key hk;
+    hmac_sha3_key_init(&hk, 32, hmac_key, sizeof(hmac_key));
+    hmac_sha3(&hk, (const uint8_t *)sample, strlen(sample), mac);
+    check_mac("HMAC-SHA3-256", mac, 32, "4fe8e202c4f058e8dddc23d8c34e467343e23555e24fc2f025d598f558f67205");
+
+    // The batch API must agree with one MAC at a time
+    const uint8_t *ptrs[7];
+    size_t lens[7];
+    uint8_t batch_macs[7 * 32], single[32];
+    int agree = 1;
+    for (int i = 0; i < 7; i++) {
+        ptrs[i] = data + i;
+        lens[i] = (size_t)(i * 29);
+    }
+    kmac_batch(&k, ptrs, lens, 7, batch_macs, 32);
+    for (int i = 0; i < 7; i++) {
+        kmac(&k, ptrs[i], lens[i], single, 32);
+        agree = agree && memcmp(single, batch_macs + i * 32, 32) == 0;
+    }
+    hmac_sha3_batch(&hk, ptrs, lens, 7, batch_macs);
+    for (int i = 0; i < 7; i++) {
+        hmac_sha3(&hk, ptrs[i], lens[i], single);
+        agree = agree && memcmp(single, batch_macs + i * 32, 32) == 0;
+    }
+    printf("Batch MACs match single MACs: %s\n", agree ? "passed" : "FAILED");
+
+    benchmark();
 
-return0;
+    PERF_REPORT(stdout);
+    return 0;
 }
 
@@ -5,39 +5,32 @@
 // AES block size in bytes
 #define AES_BLOCK_SIZE 16
 
+#include "block_modes.h"
+
 // Function prototypes
 void aes128_encrypt(const uint8_t *plaintext, const uint8_t *key, uint8_t *ciphertext);
-void xor_blocks(uint8_t *result, const uint8_t *block1, const uint8_t *block2);
-void cbc_mac(const uint8_t *message, const uint8_t *key, uint8_t *mac);
+void cbc_mac(const uint8_t *message, size_t len, const uint8_t *key, uint8_t *mac);
 
 // AES-128 encryption (dummy implementation for illustration)
 void aes128_encrypt(const uint8_t *plaintext, const uint8_t *key, uint8_t *ciphertext) {
     // Dummy implementation: XOR plaintext with key
-    for (int i = 0; i < AES_BLOCK_SIZE; i++) {
-        ciphertext[i] = plaintext[i] ^ key[i];
-    }
+    xor_block<AES_BLOCK_SIZE>(ciphertext, plaintext, key);
 }
 
-// XOR two blocks
-void xor_blocks(uint8_t *result, const uint8_t *block1, const uint8_t *block2) {
-    for (int i = 0; i < AES_BLOCK_SIZE; i++) {
-        result[i] = block1[i] ^ block2[i];
-    }
-}
-
-// CBC-MAC calculation
-void cbc_mac(const uint8_t *message, const uint8_t *key, uint8_t *mac) {
-    uint8_t temp[AES_BLOCK_SIZE];
-    uint8_t iv[AES_BLOCK_SIZE]; // Initialization vector (all zeros for the first block)
+// Dummy AES-128 backend for the block_modes.h templates
+struct aes128_cipher {
+    static constexpr size_t block_size = AES_BLOCK_SIZE;
+    const uint8_t *key;
 
-    // Encrypt the message using AES-128 in CBC mode
-    aes128_encrypt(message, key, mac); // Initialize with the first block
-
-    // XOR subsequent blocks with the previous ciphertext
-    for (int i = AES_BLOCK_SIZE; i < 2 * AES_BLOCK_SIZE; i += AES_BLOCK_SIZE) {
-        xor_blocks(temp, mac, &message[i]);
-        aes128_encrypt(temp, key, mac);
+    void encrypt_block(const uint8_t *in, uint8_t *out) const {
+        aes128_encrypt(in, key, out);
     }
+};
+
+// CBC-MAC calculation over len bytes (a whole number of blocks)
+void cbc_mac(const uint8_t *message, size_t len, const uint8_t *key, uint8_t *mac) {
+    aes128_cipher aes = { key };
+    cbc_mac(aes, message, len, mac);
 }
 
 int main() {
@@ -57,7 +50,7 @@ int main() {
     uint8_t T[AES_BLOCK_SIZE];
 
     // Compute CBC-MAC for message X
-    cbc_mac(X, key, T);
+    cbc_mac(X, AES_BLOCK_SIZE, key, T);
 
     // Print the CBC-MAC (T)
     printf("CBC-MAC (T) for X: ");
@@ -69,10 +62,10 @@ int main() {
     // Compute CBC-MAC for two-block message X || (X XOR T)
     uint8_t two_block_message[2 * AES_BLOCK_SIZE];
     memcpy(two_block_message, X, AES_BLOCK_SIZE); // Copy X
-    xor_blocks(&two_block_message[AES_BLOCK_SIZE], X, T); // Append (X XOR T)
+    xor_block<AES_BLOCK_SIZE>(&two_block_message[AES_BLOCK_SIZE], X, T); // Append (X XOR T)
 
     // Compute CBC-MAC for the two-block message
-    cbc_mac(two_block_message, key, T);
+    cbc_mac(two_block_message, 2 * AES_BLOCK_SIZE, key, T);
 
     // Print the CBC-MAC (T) for the two-block message
     printf("CBC-MAC (T) for X || (X XOR T): ");
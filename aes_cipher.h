@@ -0,0 +1,175 @@
+#ifndef AES_CIPHER_H
+#define AES_CIPHER_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <openssl/aes.h>
+
+#include "block_modes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AES_CIPHER_HAVE_AESNI 1
+#else
+#define AES_CIPHER_HAVE_AESNI 0
+#endif
+
+// AES-128 backend for the block_modes.h templates, shared by the AES
+// programs and the batching service.
+//
+// CFB, CTR and GCM only ever run the forward cipher, so the decryption key
+// schedule is expanded only when asked for: pass AES_ENCRYPT_ONLY to skip it.
+//
+// On CPUs with AES-NI the rounds run on the AES instructions, and
+// encrypt_blocks/decrypt_blocks interleave AES_CIPHER_LANES blocks so that
+// each instruction's latency is hidden behind the other blocks' rounds. The
+// ECB, CTR, CBC decryption and GCM paths hand blocks over in groups. Other
+// CPUs use OpenSSL's AES_encrypt/AES_decrypt one block at a time.
+
+#define AES_CIPHER_ROUNDS 10
+#define AES_CIPHER_LANES 8
+
+enum {
+    AES_ENCRYPT_ONLY,
+    AES_ENCRYPT_DECRYPT
+};
+
+#if AES_CIPHER_HAVE_AESNI
+
+#define AES_CIPHER_AESNI_TARGET __attribute__((target("aes,sse2")))
+
+// One step of the AES-128 key expansion; assist is aeskeygenassist of the
+// previous round key
+AES_CIPHER_AESNI_TARGET static inline __m128i aesni_expand_step(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+// Expand the encryption round keys, and the decryption round keys (the
+// encryption keys in reverse through InvMixColumns) when dec is not NULL
+AES_CIPHER_AESNI_TARGET static inline void aesni_expand_key(const unsigned char *key,
+                                                            uint8_t enc[AES_CIPHER_ROUNDS + 1][16],
+                                                            uint8_t dec[AES_CIPHER_ROUNDS + 1][16]) {
+    __m128i rk[AES_CIPHER_ROUNDS + 1];
+    rk[0] = _mm_loadu_si128((const __m128i *)key);
+    rk[1] = aesni_expand_step(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+    rk[2] = aesni_expand_step(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+    rk[3] = aesni_expand_step(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+    rk[4] = aesni_expand_step(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+    rk[5] = aesni_expand_step(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+    rk[6] = aesni_expand_step(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+    rk[7] = aesni_expand_step(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+    rk[8] = aesni_expand_step(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+    rk[9] = aesni_expand_step(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+    rk[10] = aesni_expand_step(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+
+    for (int r = 0; r <= AES_CIPHER_ROUNDS; r++) {
+        _mm_storeu_si128((__m128i *)enc[r], rk[r]);
+    }
+    if (dec != NULL) {
+        _mm_storeu_si128((__m128i *)dec[0], rk[AES_CIPHER_ROUNDS]);
+        for (int r = 1; r < AES_CIPHER_ROUNDS; r++) {
+            _mm_storeu_si128((__m128i *)dec[r], _mm_aesimc_si128(rk[AES_CIPHER_ROUNDS - r]));
+        }
+        _mm_storeu_si128((__m128i *)dec[AES_CIPHER_ROUNDS], rk[0]);
+    }
+}
+
+// Encrypt (or decrypt, with the decryption round keys) n independent blocks,
+// AES_CIPHER_LANES at a time. Each group is loaded before any of it is
+// stored, so in and out may be the same buffer.
+AES_CIPHER_AESNI_TARGET static inline void aesni_crypt_blocks(const uint8_t rk[AES_CIPHER_ROUNDS + 1][16],
+                                                              int decrypting, const uint8_t *in, uint8_t *out,
+                                                              size_t n) {
+    __m128i keys[AES_CIPHER_ROUNDS + 1];
+    for (int r = 0; r <= AES_CIPHER_ROUNDS; r++) {
+        keys[r] = _mm_loadu_si128((const __m128i *)rk[r]);
+    }
+
+    for (size_t i = 0; i < n; i += AES_CIPHER_LANES) {
+        size_t lanes = n - i < AES_CIPHER_LANES ? n - i : AES_CIPHER_LANES;
+        __m128i x[AES_CIPHER_LANES];
+        for (size_t l = 0; l < lanes; l++) {
+            x[l] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + (i + l) * 16)), keys[0]);
+        }
+        for (int r = 1; r < AES_CIPHER_ROUNDS; r++) {
+            for (size_t l = 0; l < lanes; l++) {
+                x[l] = decrypting ? _mm_aesdec_si128(x[l], keys[r]) : _mm_aesenc_si128(x[l], keys[r]);
+            }
+        }
+        for (size_t l = 0; l < lanes; l++) {
+            x[l] = decrypting ? _mm_aesdeclast_si128(x[l], keys[AES_CIPHER_ROUNDS])
+                              : _mm_aesenclast_si128(x[l], keys[AES_CIPHER_ROUNDS]);
+            _mm_storeu_si128((__m128i *)(out + (i + l) * 16), x[l]);
+        }
+    }
+}
+
+#endif // AES_CIPHER_HAVE_AESNI
+
+struct aes128_cipher {
+    static constexpr size_t block_size = AES_BLOCK_SIZE;
+    static constexpr int perf_id = PERF_AES;
+    AES_KEY enc_key;
+    AES_KEY dec_key;
+    int can_decrypt;
+    int use_aesni;                      // Clear to force the OpenSSL path
+#if AES_CIPHER_HAVE_AESNI
+    uint8_t enc_rounds[AES_CIPHER_ROUNDS + 1][16];
+    uint8_t dec_rounds[AES_CIPHER_ROUNDS + 1][16];
+#endif
+
+    explicit aes128_cipher(const unsigned char *key, int directions = AES_ENCRYPT_DECRYPT) {
+        can_decrypt = directions == AES_ENCRYPT_DECRYPT;
+        use_aesni = 0;
+        PERF_KEY_SETUP(PERF_AES, can_decrypt ? 2 : 1);
+        AES_set_encrypt_key(key, 128, &enc_key);
+        if (can_decrypt) {
+            AES_set_decrypt_key(key, 128, &dec_key);
+        }
+#if AES_CIPHER_HAVE_AESNI
+        if (__builtin_cpu_supports("aes")) {
+            aesni_expand_key(key, enc_rounds, can_decrypt ? dec_rounds : NULL);
+            use_aesni = 1;
+        }
+#endif
+    }
+
+    void encrypt_block(const uint8_t *in, uint8_t *out) const {
+        encrypt_blocks(in, out, 1);
+    }
+
+    void decrypt_block(const uint8_t *in, uint8_t *out) const {
+        decrypt_blocks(in, out, 1);
+    }
+
+    void encrypt_blocks(const uint8_t *in, uint8_t *out, size_t n) const {
+#if AES_CIPHER_HAVE_AESNI
+        if (use_aesni) {
+            aesni_crypt_blocks(enc_rounds, 0, in, out, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++) {
+            AES_encrypt(in + i * AES_BLOCK_SIZE, out + i * AES_BLOCK_SIZE, &enc_key);
+        }
+    }
+
+    void decrypt_blocks(const uint8_t *in, uint8_t *out, size_t n) const {
+        assert(can_decrypt);
+#if AES_CIPHER_HAVE_AESNI
+        if (use_aesni) {
+            aesni_crypt_blocks(dec_rounds, 1, in, out, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++) {
+            AES_decrypt(in + i * AES_BLOCK_SIZE, out + i * AES_BLOCK_SIZE, &dec_key);
+        }
+    }
+};
+
+#endif // AES_CIPHER_H
@@ -0,0 +1,170 @@
+#ifndef AES_SERVICE_H
+#define AES_SERVICE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "aes_cipher.h"
+#include "block_modes.h"
+
+// Protocol of the local AES batching service ("21.AES service daemon").
+//
+// A client connects to the SOCK_SEQPACKET Unix socket and sends one
+// aes_service_hello carrying a memfd for a shared buffer. Record data never
+// crosses the socket: the client writes a record into its shared buffer and
+// sends an aes_service_request naming the key, the mode and the byte range.
+// The daemon encrypts or decrypts that range in place and answers with an
+// aes_service_reply carrying the same id.
+//
+// The socket lives in a directory only its owner can enter
+// ($XDG_RUNTIME_DIR, or /tmp/aes_service-<uid>), and the daemon only serves
+// clients running as its own user. The memfd must carry F_SEAL_SHRINK so a
+// client cannot pull the buffer out from under the daemon.
+
+#define AES_SERVICE_SOCKET_NAME "aes_service.sock"
+#define AES_SERVICE_MAX_KEYS 256
+#define AES_SERVICE_DEMO_KEYS 16
+
+enum {
+    AES_OP_ECB_ENCRYPT,
+    AES_OP_ECB_DECRYPT,
+    AES_OP_CBC_ENCRYPT,
+    AES_OP_CBC_DECRYPT,
+    AES_OP_CFB_ENCRYPT,
+    AES_OP_CFB_DECRYPT,
+    AES_OP_COUNT
+};
+
+enum {
+    AES_STATUS_OK = 0,
+    AES_STATUS_BAD_KEY = -1,        // Unknown key id
+    AES_STATUS_BAD_RANGE = -2,      // Range outside the shared buffer
+    AES_STATUS_BAD_REQUEST = -3     // Unknown op, or ECB/CBC length not a multiple of the block size
+};
+
+typedef struct {
+    uint64_t shm_size;              // Size of the buffer behind the attached fd
+} aes_service_hello;
+
+typedef struct {
+    uint32_t id;                    // Echoed in the reply
+    uint16_t key_id;
+    uint8_t op;                     // AES_OP_*
+    uint8_t reserved;
+    uint32_t offset;                // Byte range in the shared buffer
+    uint32_t length;
+    uint8_t iv[AES_BLOCK_SIZE];     // Ignored for ECB
+} aes_service_request;
+
+typedef struct {
+    uint32_t id;
+    int32_t status;                 // AES_STATUS_*
+} aes_service_reply;
+
+// Demo key id: the 21.cpp key with its first byte XORed with id
+static inline void aes_service_demo_key(int id, unsigned char key[AES_BLOCK_SIZE]) {
+    memcpy(key, "1234567890123456", AES_BLOCK_SIZE);
+    key[0] ^= (unsigned char)id;
+}
+
+// Build the socket path, creating its directory when asked. Fails unless the
+// directory belongs to this user and nobody else can use it.
+static inline int aes_service_socket_path(char *path, size_t size, int create) {
+    char dir[256];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != NULL && runtime[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s", runtime);
+    } else {
+        snprintf(dir, sizeof(dir), "/tmp/aes_service-%u", (unsigned)geteuid());
+        if (create && mkdir(dir, 0700) != 0 && errno != EEXIST) {
+            perror(dir);
+            return -1;
+        }
+    }
+
+    struct stat st;
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+        fprintf(stderr, "%s is not a private directory of this user\n", dir);
+        return -1;
+    }
+    if ((size_t)snprintf(path, size, "%s/%s", dir, AES_SERVICE_SOCKET_NAME) >= size) {
+        fprintf(stderr, "Socket path too long\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Connect to the daemon and hand it a shared buffer of shm_size bytes.
+// Returns the socket, or -1 on failure; *shm receives the client's mapping.
+static inline int aes_service_connect(const char *path, size_t shm_size, uint8_t **shm) {
+    int memfd = memfd_create("aes_service", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0 || ftruncate(memfd, (off_t)shm_size) != 0 ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) != 0) {
+        perror("memfd_create");
+        if (memfd >= 0) {
+            close(memfd);
+        }
+        return -1;
+    }
+    void *map = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        close(memfd);
+        return -1;
+    }
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        if (sock >= 0) {
+            close(sock);
+        }
+        munmap(map, shm_size);
+        close(memfd);
+        return -1;
+    }
+
+    // Pass the memfd along with the hello message
+    aes_service_hello hello = { shm_size };
+    struct iovec iov = { &hello, sizeof(hello) };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+    int sent = sendmsg(sock, &msg, 0) == (ssize_t)sizeof(hello);
+    close(memfd);
+    if (!sent) {
+        perror("sendmsg");
+        close(sock);
+        munmap(map, shm_size);
+        return -1;
+    }
+
+    *shm = (uint8_t *)map;
+    return sock;
+}
+
+#endif // AES_SERVICE_H
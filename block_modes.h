@@ -0,0 +1,357 @@
+#ifndef BLOCK_MODES_H
+#define BLOCK_MODES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "perf_counters.h"
+
+// Block cipher modes of operation shared by the DES, S-DES and AES programs.
+//
+// A cipher backend is any type that provides
+//
+//     static constexpr size_t block_size;
+//     void encrypt_block(const uint8_t *in, uint8_t *out) const;
+//     void decrypt_block(const uint8_t *in, uint8_t *out) const;   // ECB/CBC decrypt only
+//
+// where in and out may point to the same block.
+//
+// Because the block size is a compile-time constant, the cipher call and the
+// XOR are inlined into the mode loop, and every backend gets all of the modes
+// below without writing them again. A backend may also declare
+//
+//     static constexpr int perf_id;                                // PERF_AES, PERF_DES, ...
+//
+// to have its mode calls counted under its own name in perf_counters.h, and
+//
+//     void encrypt_blocks(const uint8_t *in, uint8_t *out, size_t n) const;
+//     void decrypt_blocks(const uint8_t *in, uint8_t *out, size_t n) const;
+//
+// to take n independent blocks at once, so that a pipelined implementation
+// (AES-NI, say) keeps several blocks in flight. Backends without them get
+// one encrypt_block or decrypt_block call per block.
+
+// Number of independent blocks handed to the cipher at once on the parallel
+// paths (ECB, CTR and CBC decryption)
+#define BLOCK_MODES_LANES 8
+
+// XOR two blocks a machine word at a time (the compiler turns this into a
+// single SIMD operation for 8 and 16 byte blocks)
+template <size_t N>
+inline void xor_block(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+    size_t i = 0;
+    for (; i + 8 <= N; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x ^= y;
+        memcpy(out + i, &x, 8);
+    }
+    for (; i < N; i++) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+// XOR len bytes, used for the trailing partial block of the stream modes
+inline void xor_bytes(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+// Increment a big-endian counter block
+template <size_t N>
+inline void ctr_increment(uint8_t *counter) {
+    for (size_t i = N; i-- > 0;) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+// Encrypt n independent blocks through the backend's encrypt_blocks when it
+// has one, one block at a time otherwise
+template <class Cipher>
+inline auto cipher_encrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n, int)
+    -> decltype(cipher.encrypt_blocks(in, out, n)) {
+    cipher.encrypt_blocks(in, out, n);
+}
+
+template <class Cipher>
+inline void cipher_encrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n, long) {
+    for (size_t i = 0; i < n; i++) {
+        cipher.encrypt_block(in + i * Cipher::block_size, out + i * Cipher::block_size);
+    }
+}
+
+template <class Cipher>
+inline void cipher_encrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n) {
+    cipher_encrypt_blocks(cipher, in, out, n, 0);
+}
+
+// Decrypt n independent blocks, likewise
+template <class Cipher>
+inline auto cipher_decrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n, int)
+    -> decltype(cipher.decrypt_blocks(in, out, n)) {
+    cipher.decrypt_blocks(in, out, n);
+}
+
+template <class Cipher>
+inline void cipher_decrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n, long) {
+    for (size_t i = 0; i < n; i++) {
+        cipher.decrypt_block(in + i * Cipher::block_size, out + i * Cipher::block_size);
+    }
+}
+
+template <class Cipher>
+inline void cipher_decrypt_blocks(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t n) {
+    cipher_decrypt_blocks(cipher, in, out, n, 0);
+}
+
+// ECB encryption of len / block_size whole blocks
+template <class Cipher>
+void ecb_encrypt(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_ECB, blocks, blocks * B);
+
+    cipher_encrypt_blocks(cipher, in, out, blocks);
+}
+
+// ECB decryption of len / block_size whole blocks
+template <class Cipher>
+void ecb_decrypt(const Cipher &cipher, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_ECB, blocks, blocks * B);
+
+    cipher_decrypt_blocks(cipher, in, out, blocks);
+}
+
+// CBC encryption of len / block_size whole blocks. iv is updated to the last
+// ciphertext block so that consecutive calls chain like one long message.
+template <class Cipher>
+void cbc_encrypt(const Cipher &cipher, uint8_t *iv, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B;
+    uint8_t chain[B];
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_CBC, blocks, blocks * B);
+
+    memcpy(chain, iv, B);
+    for (size_t i = 0; i < blocks; i++) {
+        xor_block<B>(chain, chain, in + i * B);
+        cipher.encrypt_block(chain, chain);
+        memcpy(out + i * B, chain, B);
+    }
+    memcpy(iv, chain, B);
+}
+
+// CBC decryption of len / block_size whole blocks. Each plaintext block only
+// depends on two ciphertext blocks, so the block decryptions are handed to the
+// cipher BLOCK_MODES_LANES at a time. in and out may be the same buffer.
+template <class Cipher>
+void cbc_decrypt(const Cipher &cipher, uint8_t *iv, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B, i = 0;
+    uint8_t chain[B], next[B];
+    uint8_t tmp[BLOCK_MODES_LANES * B];
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_CBC, blocks, blocks * B);
+
+    memcpy(chain, iv, B);
+    for (; i + BLOCK_MODES_LANES <= blocks; i += BLOCK_MODES_LANES) {
+        const uint8_t *src = in + i * B;
+        uint8_t *dst = out + i * B;
+
+        cipher_decrypt_blocks(cipher, src, tmp, BLOCK_MODES_LANES);
+        memcpy(next, src + (BLOCK_MODES_LANES - 1) * B, B);
+
+        // Walk backwards so an in-place call never overwrites a ciphertext
+        // block that is still needed as the chaining value
+        for (int l = BLOCK_MODES_LANES - 1; l > 0; l--) {
+            xor_block<B>(dst + l * B, tmp + l * B, src + (l - 1) * B);
+        }
+        xor_block<B>(dst, tmp, chain);
+        memcpy(chain, next, B);
+    }
+    for (; i < blocks; i++) {
+        memcpy(next, in + i * B, B);
+        cipher.decrypt_block(next, tmp);
+        xor_block<B>(out + i * B, tmp, chain);
+        memcpy(chain, next, B);
+    }
+    memcpy(iv, chain, B);
+}
+
+// Decrypt only the bytes [offset, offset + len) of a CBC ciphertext of
+// in_len bytes. Plaintext block i depends only on ciphertext blocks i - 1 and
+// i, so only the blocks covering the range are touched. Returns the number of
+// bytes written to out, which is shorter than len if the range runs past the
+// last whole block.
+template <class Cipher>
+size_t cbc_decrypt_range(const Cipher &cipher, const uint8_t *iv, const uint8_t *in, size_t in_len,
+                         size_t offset, size_t len, uint8_t *out) {
+    const size_t B = Cipher::block_size;
+    size_t total = in_len / B * B;
+    size_t block = offset / B, skip = offset % B, done = 0;
+    uint8_t chain[B], plain[B];
+
+    if (offset >= total || len == 0) {
+        return 0;
+    }
+    if (len > total - offset) {
+        len = total - offset;
+    }
+    memcpy(chain, block ? in + (block - 1) * B : iv, B);
+
+    // Leading partial block
+    if (skip) {
+        size_t n = B - skip < len ? B - skip : len;
+        cipher.decrypt_block(in + block * B, plain);
+        xor_block<B>(plain, plain, chain);
+        memcpy(out, plain + skip, n);
+        memcpy(chain, in + block * B, B);
+        done = n;
+        block++;
+    }
+
+    // Whole blocks go straight into the caller's buffer
+    size_t whole = (len - done) / B * B;
+    cbc_decrypt(cipher, chain, in + block * B, out + done, whole);
+    done += whole;
+    block += whole / B;
+
+    // Trailing partial block
+    if (done < len) {
+        cipher.decrypt_block(in + block * B, plain);
+        xor_block<B>(plain, plain, chain);
+        memcpy(out + done, plain, len - done);
+    }
+    return len;
+}
+
+// CBC decryption of len / block_size whole blocks split across threads by
+// block range. Each thread starts from the ciphertext block before its range,
+// so no thread waits on another. in and out may be the same buffer; iv is
+// updated like cbc_decrypt.
+template <class Cipher>
+void cbc_decrypt_parallel(const Cipher &cipher, uint8_t *iv, const uint8_t *in, uint8_t *out, size_t len,
+                          unsigned threads) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B;
+
+    if (threads < 2 || blocks < 2 * (size_t)threads * BLOCK_MODES_LANES) {
+        cbc_decrypt(cipher, iv, in, out, len);
+        return;
+    }
+
+    // Capture every chaining value up front: with in == out the previous
+    // thread may overwrite it before this one starts
+    std::vector<uint8_t> chains(threads * B);
+    std::vector<std::thread> workers;
+    size_t per_thread = blocks / threads;
+    uint8_t last[B];
+
+    memcpy(last, in + (blocks - 1) * B, B);
+    for (unsigned t = 0; t < threads; t++) {
+        size_t first = t * per_thread;
+        memcpy(&chains[t * B], first ? in + (first - 1) * B : iv, B);
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        size_t first = t * per_thread;
+        size_t count = t == threads - 1 ? blocks - first : per_thread;
+        uint8_t *chain = &chains[t * B];
+        workers.emplace_back([&cipher, chain, in, out, first, count, B]() {
+            cbc_decrypt(cipher, chain, in + first * B, out + first * B, count * B);
+        });
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    memcpy(iv, last, B);
+}
+
+// Full-block CFB encryption. A trailing partial block is XORed with a prefix
+// of the keystream block, so any length is accepted.
+template <class Cipher>
+void cfb_encrypt(const Cipher &cipher, uint8_t *iv, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    uint8_t keystream[B];
+    size_t i = 0;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_CFB, (len + B - 1) / B, len);
+
+    for (; i + B <= len; i += B) {
+        cipher.encrypt_block(iv, keystream);
+        xor_block<B>(out + i, keystream, in + i);
+        memcpy(iv, out + i, B);
+    }
+    if (i < len) {
+        cipher.encrypt_block(iv, keystream);
+        xor_bytes(out + i, keystream, in + i, len - i);
+    }
+}
+
+// Full-block CFB decryption, the inverse of cfb_encrypt
+template <class Cipher>
+void cfb_decrypt(const Cipher &cipher, uint8_t *iv, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    uint8_t keystream[B];
+    size_t i = 0;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_CFB, (len + B - 1) / B, len);
+
+    for (; i + B <= len; i += B) {
+        cipher.encrypt_block(iv, keystream);
+        memcpy(iv, in + i, B);
+        xor_block<B>(out + i, keystream, iv);
+    }
+    if (i < len) {
+        cipher.encrypt_block(iv, keystream);
+        xor_bytes(out + i, keystream, in + i, len - i);
+    }
+}
+
+// CTR mode (encryption and decryption are the same operation). counter is a
+// big-endian block that is advanced past the blocks consumed.
+template <class Cipher>
+void ctr_crypt(const Cipher &cipher, uint8_t *counter, const uint8_t *in, uint8_t *out, size_t len) {
+    const size_t B = Cipher::block_size;
+    uint8_t ctrs[BLOCK_MODES_LANES * B];
+    uint8_t keystream[BLOCK_MODES_LANES * B];
+    size_t i = 0;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_CTR, (len + B - 1) / B, len);
+
+    for (; i + BLOCK_MODES_LANES * B <= len; i += BLOCK_MODES_LANES * B) {
+        for (int l = 0; l < BLOCK_MODES_LANES; l++) {
+            memcpy(ctrs + l * B, counter, B);
+            ctr_increment<B>(counter);
+        }
+        cipher_encrypt_blocks(cipher, ctrs, keystream, BLOCK_MODES_LANES);
+        for (int l = 0; l < BLOCK_MODES_LANES; l++) {
+            xor_block<B>(out + i + l * B, keystream + l * B, in + i + l * B);
+        }
+    }
+    for (; i < len; i += B) {
+        size_t n = len - i < B ? len - i : B;
+        cipher.encrypt_block(counter, keystream);
+        ctr_increment<B>(counter);
+        xor_bytes(out + i, keystream, in + i, n);
+    }
+}
+
+// CBC-MAC over len / block_size whole blocks with a zero IV
+template <class Cipher>
+void cbc_mac(const Cipher &cipher, const uint8_t *message, size_t len, uint8_t *mac) {
+    const size_t B = Cipher::block_size;
+    size_t blocks = len / B;
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_MAC, blocks, blocks * B);
+
+    memset(mac, 0, B);
+    for (size_t i = 0; i < blocks; i++) {
+        xor_block<B>(mac, mac, message + i * B);
+        cipher.encrypt_block(mac, mac);
+    }
+}
+
+#endif // BLOCK_MODES_H
@@ -0,0 +1,203 @@
+#ifndef DES_CORE_H
+#define DES_CORE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "des_key_schedule.h"
+
+// Table-driven DES block encryption on 64-bit blocks, consuming the subkeys
+// produced by des_key_schedule.h.
+//
+// The S-boxes are merged with the P permutation into eight 64-entry tables, so
+// a round is eight lookups and the initial and final permutations are eight
+// byte-indexed lookups each.
+
+static const int des_ip[64] = {
+    58, 50, 42, 34, 26, 18, 10, 2,
+    60, 52, 44, 36, 28, 20, 12, 4,
+    62, 54, 46, 38, 30, 22, 14, 6,
+    64, 56, 48, 40, 32, 24, 16, 8,
+    57, 49, 41, 33, 25, 17, 9, 1,
+    59, 51, 43, 35, 27, 19, 11, 3,
+    61, 53, 45, 37, 29, 21, 13, 5,
+    63, 55, 47, 39, 31, 23, 15, 7
+};
+
+static const int des_fp[64] = {
+    40, 8, 48, 16, 56, 24, 64, 32,
+    39, 7, 47, 15, 55, 23, 63, 31,
+    38, 6, 46, 14, 54, 22, 62, 30,
+    37, 5, 45, 13, 53, 21, 61, 29,
+    36, 4, 44, 12, 52, 20, 60, 28,
+    35, 3, 43, 11, 51, 19, 59, 27,
+    34, 2, 42, 10, 50, 18, 58, 26,
+    33, 1, 41, 9, 49, 17, 57, 25
+};
+
+static const int des_p[32] = {
+    16, 7, 20, 21, 29, 12, 28, 17,
+    1, 15, 23, 26, 5, 18, 31, 10,
+    2, 8, 24, 14, 32, 27, 3, 9,
+    19, 13, 30, 6, 22, 11, 4, 25
+};
+
+static const uint8_t des_sbox[8][4][16] = {
+    {{14, 4, 13, 1, 2, 15, 11, 8, 3, 10, 6, 12, 5, 9, 0, 7},
+     {0, 15, 7, 4, 14, 2, 13, 1, 10, 6, 12, 11, 9, 5, 3, 8},
+     {4, 1, 14, 8, 13, 6, 2, 11, 15, 12, 9, 7, 3, 10, 5, 0},
+     {15, 12, 8, 2, 4, 9, 1, 7, 5, 11, 3, 14, 10, 0, 6, 13}},
+    {{15, 1, 8, 14, 6, 11, 3, 4, 9, 7, 2, 13, 12, 0, 5, 10},
+     {3, 13, 4, 7, 15, 2, 8, 14, 12, 0, 1, 10, 6, 9, 11, 5},
+     {0, 14, 7, 11, 10, 4, 13, 1, 5, 8, 12, 6, 9, 3, 2, 15},
+     {13, 8, 10, 1, 3, 15, 4, 2, 11, 6, 7, 12, 0, 5, 14, 9}},
+    {{10, 0, 9, 14, 6, 3, 15, 5, 1, 13, 12, 7, 11, 4, 2, 8},
+     {13, 7, 0, 9, 3, 4, 6, 10, 2, 8, 5, 14, 12, 11, 15, 1},
+     {13, 6, 4, 9, 8, 15, 3, 0, 11, 1, 2, 12, 5, 10, 14, 7},
+     {1, 10, 13, 0, 6, 9, 8, 7, 4, 15, 14, 3, 11, 5, 2, 12}},
+    {{7, 13, 14, 3, 0, 6, 9, 10, 1, 2, 8, 5, 11, 12, 4, 15},
+     {13, 8, 11, 5, 6, 15, 0, 3, 4, 7, 2, 12, 1, 10, 14, 9},
+     {10, 6, 9, 0, 12, 11, 7, 13, 15, 1, 3, 14, 5, 2, 8, 4},
+     {3, 15, 0, 6, 10, 1, 13, 8, 9, 4, 5, 11, 12, 7, 2, 14}},
+    {{2, 12, 4, 1, 7, 10, 11, 6, 8, 5, 3, 15, 13, 0, 14, 9},
+     {14, 11, 2, 12, 4, 7, 13, 1, 5, 0, 15, 10, 3, 9, 8, 6},
+     {4, 2, 1, 11, 10, 13, 7, 8, 15, 9, 12, 5, 6, 3, 0, 14},
+     {11, 8, 12, 7, 1, 14, 2, 13, 6, 15, 0, 9, 10, 4, 5, 3}},
+    {{12, 1, 10, 15, 9, 2, 6, 8, 0, 13, 3, 4, 14, 7, 5, 11},
+     {10, 15, 4, 2, 7, 12, 9, 5, 6, 1, 13, 14, 0, 11, 3, 8},
+     {9, 14, 15, 5, 2, 8, 12, 3, 7, 0, 4, 10, 1, 13, 11, 6},
+     {4, 3, 2, 12, 9, 5, 15, 10, 11, 14, 1, 7, 6, 0, 8, 13}},
+    {{4, 11, 2, 14, 15, 0, 8, 13, 3, 12, 9, 7, 5, 10, 6, 1},
+     {13, 0, 11, 7, 4, 9, 1, 10, 14, 3, 5, 12, 2, 15, 8, 6},
+     {1, 4, 11, 13, 12, 3, 7, 14, 10, 15, 6, 8, 0, 5, 9, 2},
+     {6, 11, 13, 8, 1, 4, 10, 7, 9, 5, 0, 15, 14, 2, 3, 12}},
+    {{13, 2, 8, 4, 6, 15, 11, 1, 10, 9, 3, 14, 5, 0, 12, 7},
+     {1, 15, 13, 8, 10, 3, 7, 4, 12, 5, 6, 11, 0, 14, 9, 2},
+     {7, 11, 4, 1, 9, 12, 14, 2, 0, 6, 10, 13, 15, 3, 5, 8},
+     {2, 1, 14, 7, 4, 10, 8, 13, 15, 12, 9, 0, 3, 5, 6, 11}}
+};
+
+static uint32_t des_sp[8][64];          // S-box i followed by P
+static uint64_t des_ip_bytes[8][256];   // Byte-indexed initial permutation
+static uint64_t des_fp_bytes[8][256];   // Byte-indexed final permutation
+
+static inline void des_permutation_bytes(const int perm[64], uint64_t table[8][256]) {
+    memset(table, 0, sizeof(uint64_t) * 8 * 256);
+    for (int i = 0; i < 64; i++) {
+        int src = perm[i] - 1;
+        for (int v = 0; v < 256; v++) {
+            if ((v >> (7 - src % 8)) & 1) {
+                table[src / 8][v] |= (uint64_t)1 << (63 - i);
+            }
+        }
+    }
+}
+
+// Build the lookup tables
+static void des_core_build(void) {
+    des_key_tables_init();
+    des_permutation_bytes(des_ip, des_ip_bytes);
+    des_permutation_bytes(des_fp, des_fp_bytes);
+
+    for (int s = 0; s < 8; s++) {
+        for (int x = 0; x < 64; x++) {
+            int row = ((x >> 4) & 2) | (x & 1);
+            int col = (x >> 1) & 15;
+            uint32_t sout = (uint32_t)des_sbox[s][row][col] << (28 - 4 * s);
+            uint32_t pout = 0;
+            for (int i = 0; i < 32; i++) {
+                pout |= ((sout >> (32 - des_p[i])) & 1) << (31 - i);
+            }
+            des_sp[s][x] = pout;
+        }
+    }
+}
+
+// Build the lookup tables on first use; safe to call from several threads
+static inline void des_core_init(void) {
+    static std::once_flag once;
+    std::call_once(once, des_core_build);
+}
+
+static inline uint64_t des_permute_bytes(uint64_t block, const uint64_t table[8][256]) {
+    uint64_t out = 0;
+    for (int b = 0; b < 8; b++) {
+        out |= table[b][(block >> (56 - 8 * b)) & 0xFF];
+    }
+    return out;
+}
+
+// Round function: expansion, subkey XOR, S-boxes and P
+static inline uint32_t des_feistel(uint32_t r, uint64_t subkey) {
+    uint32_t rr = (r >> 1) | (r << 31);     // Bits 32,1..5 at the top
+    uint32_t rl = (r << 1) | (r >> 31);     // Bits 28..32,1 at the bottom
+
+    return des_sp[0][((rr >> 26) ^ (uint32_t)(subkey >> 42)) & 63] |
+           des_sp[1][((r >> 23) ^ (uint32_t)(subkey >> 36)) & 63] |
+           des_sp[2][((r >> 19) ^ (uint32_t)(subkey >> 30)) & 63] |
+           des_sp[3][((r >> 15) ^ (uint32_t)(subkey >> 24)) & 63] |
+           des_sp[4][((r >> 11) ^ (uint32_t)(subkey >> 18)) & 63] |
+           des_sp[5][((r >> 7) ^ (uint32_t)(subkey >> 12)) & 63] |
+           des_sp[6][((r >> 3) ^ (uint32_t)(subkey >> 6)) & 63] |
+           des_sp[7][(rl ^ (uint32_t)subkey) & 63];
+}
+
+// Encrypt one block
+static inline uint64_t des_encrypt_block(uint64_t block, const uint64_t subkeys[DES_ROUNDS]) {
+    uint64_t ip = des_permute_bytes(block, des_ip_bytes);
+    uint32_t l = (uint32_t)(ip >> 32), r = (uint32_t)ip;
+
+    for (int round = 0; round < DES_ROUNDS; round++) {
+        uint32_t t = l ^ des_feistel(r, subkeys[round]);
+        l = r;
+        r = t;
+    }
+    return des_permute_bytes(((uint64_t)r << 32) | l, des_fp_bytes);
+}
+
+// Decrypt one block
+static inline uint64_t des_decrypt_block(uint64_t block, const uint64_t subkeys[DES_ROUNDS]) {
+    uint64_t ip = des_permute_bytes(block, des_ip_bytes);
+    uint32_t l = (uint32_t)(ip >> 32), r = (uint32_t)ip;
+
+    for (int round = DES_ROUNDS - 1; round >= 0; round--) {
+        uint32_t t = l ^ des_feistel(r, subkeys[round]);
+        l = r;
+        r = t;
+    }
+    return des_permute_bytes(((uint64_t)r << 32) | l, des_fp_bytes);
+}
+
+// The 16 rounds for four keys at once, without IP and FP: ip_block is an
+// already permuted block and out receives R16||L16 before FP. The four
+// rounds are independent, so their table lookups overlap instead of waiting
+// on each other. Key search compares these values against IP(ciphertext)
+// and skips both permutations.
+static inline void des_rounds_x4(uint64_t ip_block, const uint64_t subkeys[4][DES_ROUNDS], uint64_t out[4]) {
+    uint32_t l[4], r[4];
+
+    for (int k = 0; k < 4; k++) {
+        l[k] = (uint32_t)(ip_block >> 32);
+        r[k] = (uint32_t)ip_block;
+    }
+    for (int round = 0; round < DES_ROUNDS; round++) {
+        for (int k = 0; k < 4; k++) {
+            uint32_t t = l[k] ^ des_feistel(r[k], subkeys[k][round]);
+            l[k] = r[k];
+            r[k] = t;
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        out[k] = ((uint64_t)r[k] << 32) | l[k];
+    }
+}
+
+// Encrypt one block under four keys at once
+static inline void des_encrypt_block_x4(uint64_t block, const uint64_t subkeys[4][DES_ROUNDS], uint64_t out[4]) {
+    des_rounds_x4(des_permute_bytes(block, des_ip_bytes), subkeys, out);
+    for (int k = 0; k < 4; k++) {
+        out[k] = des_permute_bytes(out[k], des_fp_bytes);
+    }
+}
+
+#endif // DES_CORE_H
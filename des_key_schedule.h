@@ -0,0 +1,192 @@
+#ifndef DES_KEY_SCHEDULE_H
+#define DES_KEY_SCHEDULE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+
+#include "perf_counters.h"
+
+// DES key schedule engine.
+//
+// Single keys go through byte-indexed PC-1 and PC-2 tables: eight lookups
+// replace the 56-iteration PC-1 bit loop, and seven lookups per round replace
+// the 48-iteration PC-2 loop.
+//
+// Batches of 64 keys are bitsliced: the keys are transposed so that word j
+// holds key bit j of all 64 keys, and since the whole schedule (PC-1, the
+// rotations and PC-2) is a fixed wiring of key bits, every subkey bit of every
+// round is then a single word copy. The result stays in bitsliced
+// struct-of-arrays form (slice[round][bit], one lane per key), the layout a
+// bitsliced DES round function would take. No such round function exists in
+// this tree yet, so the batch schedule is standalone: callers either read the
+// slices themselves or use des_subkey_batch_extract to turn them back into
+// ordinary per-key subkeys laid out round-major, and its speedup over the
+// single-key path covers schedule generation only.
+//
+// Bits are numbered as in the DES standard: bit 1 is the most significant
+// bit of the 64-bit key, and subkeys are 48-bit values with bit 1 at bit 47.
+
+#define DES_ROUNDS 16
+#define DES_SUBKEY_BITS 48
+#define DES_BATCH_KEYS 64
+
+// Permuted choice 1: 64-bit key -> 56-bit C||D
+static const int des_pc1[56] = {
+    57, 49, 41, 33, 25, 17, 9, 1,
+    58, 50, 42, 34, 26, 18, 10, 2,
+    59, 51, 43, 35, 27, 19, 11, 3,
+    60, 52, 44, 36, 63, 55, 47, 39,
+    31, 23, 15, 7, 62, 54, 46, 38,
+    30, 22, 14, 6, 61, 53, 45, 37,
+    29, 21, 13, 5, 28, 20, 12, 4
+};
+
+// Permuted choice 2: 56-bit C||D -> 48-bit subkey
+static const int des_pc2[48] = {
+    14, 17, 11, 24, 1, 5, 3, 28,
+    15, 6, 21, 10, 23, 19, 12, 4,
+    26, 8, 16, 7, 27, 20, 13, 2,
+    41, 52, 31, 37, 47, 55, 30, 40,
+    51, 45, 33, 48, 44, 49, 39, 56,
+    34, 53, 46, 42, 50, 36, 29, 32
+};
+
+// Left rotations of C and D before each round
+static const int des_shifts[DES_ROUNDS] = {
+    1, 1, 2, 2, 2, 2, 2, 2,
+    1, 2, 2, 2, 2, 2, 2, 1
+};
+
+// Subkeys for a batch of 64 keys in bitsliced form: bit (63 - k) of
+// slice[r][i] is bit i + 1 of round r's subkey for key k
+typedef struct {
+    uint64_t slice[DES_ROUNDS][DES_SUBKEY_BITS];
+} des_subkey_batch;
+
+static uint64_t des_pc1_bytes[8][256];                  // Key byte -> C||D bits
+static uint64_t des_pc2_bytes[7][256];                  // C||D byte -> subkey bits
+static uint8_t des_subkey_source[DES_ROUNDS][DES_SUBKEY_BITS];  // Key bit feeding each subkey bit
+
+// Build the byte-indexed tables and the bitsliced wiring from the standard
+// tables
+static void des_key_tables_build(void) {
+    memset(des_pc1_bytes, 0, sizeof(des_pc1_bytes));
+    for (int i = 0; i < 56; i++) {
+        int src = des_pc1[i] - 1;
+        for (int v = 0; v < 256; v++) {
+            if ((v >> (7 - src % 8)) & 1) {
+                des_pc1_bytes[src / 8][v] |= (uint64_t)1 << (55 - i);
+            }
+        }
+    }
+
+    memset(des_pc2_bytes, 0, sizeof(des_pc2_bytes));
+    for (int i = 0; i < DES_SUBKEY_BITS; i++) {
+        int src = des_pc2[i] - 1;
+        for (int v = 0; v < 256; v++) {
+            if ((v >> (7 - src % 8)) & 1) {
+                des_pc2_bytes[src / 8][v] |= (uint64_t)1 << (47 - i);
+            }
+        }
+    }
+
+    // Follow each subkey bit back through PC-2, the accumulated rotation and
+    // PC-1 to the key bit it comes from
+    int rotation = 0;
+    for (int r = 0; r < DES_ROUNDS; r++) {
+        rotation += des_shifts[r];
+        for (int i = 0; i < DES_SUBKEY_BITS; i++) {
+            int cd = des_pc2[i] - 1;
+            int half = cd / 28 * 28;
+            int pre = half + (cd - half + rotation) % 28;
+            des_subkey_source[r][i] = (uint8_t)(des_pc1[pre] - 1);
+        }
+    }
+}
+
+// Build the tables on first use. Called by the schedule functions, and safe
+// to reach from several threads at once.
+static inline void des_key_tables_init(void) {
+    static std::once_flag once;
+    std::call_once(once, des_key_tables_build);
+}
+
+static inline uint64_t des_permuted_choice1(uint64_t key) {
+    uint64_t cd = 0;
+    for (int b = 0; b < 8; b++) {
+        cd |= des_pc1_bytes[b][(key >> (56 - 8 * b)) & 0xFF];
+    }
+    return cd;
+}
+
+static inline uint64_t des_permuted_choice2(uint64_t cd) {
+    uint64_t subkey = 0;
+    for (int b = 0; b < 7; b++) {
+        subkey |= des_pc2_bytes[b][(cd >> (48 - 8 * b)) & 0xFF];
+    }
+    return subkey;
+}
+
+// Expand one key into its 16 subkeys
+static inline void des_key_schedule(uint64_t key, uint64_t subkeys[DES_ROUNDS]) {
+    PERF_KEY_SETUP(PERF_DES, 1);
+    des_key_tables_init();
+
+    uint64_t cd = des_permuted_choice1(key);
+    uint32_t c = (uint32_t)(cd >> 28) & 0x0FFFFFFF;
+    uint32_t d = (uint32_t)cd & 0x0FFFFFFF;
+
+    for (int r = 0; r < DES_ROUNDS; r++) {
+        int s = des_shifts[r];
+        c = ((c << s) | (c >> (28 - s))) & 0x0FFFFFFF;
+        d = ((d << s) | (d >> (28 - s))) & 0x0FFFFFFF;
+        subkeys[r] = des_permuted_choice2(((uint64_t)c << 28) | d);
+    }
+}
+
+// Transpose a 64x64 bit matrix in place: afterwards bit (63 - c) of a[r] is
+// what bit (63 - r) of a[c] was
+static inline void des_transpose64(uint64_t a[64]) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = (a[k] ^ (a[k | j] >> j)) & m;
+            a[k] ^= t;
+            a[k | j] ^= t << j;
+        }
+    }
+}
+
+// Expand 64 keys at once into bitsliced subkeys
+static inline void des_key_schedule_batch64(const uint64_t keys[DES_BATCH_KEYS], des_subkey_batch *out) {
+    uint64_t slices[64];
+
+    PERF_KEY_SETUP(PERF_DES, DES_BATCH_KEYS);
+    des_key_tables_init();
+    memcpy(slices, keys, sizeof(slices));
+    des_transpose64(slices);
+
+    for (int r = 0; r < DES_ROUNDS; r++) {
+        for (int i = 0; i < DES_SUBKEY_BITS; i++) {
+            out->slice[r][i] = slices[des_subkey_source[r][i]];
+        }
+    }
+}
+
+// Convert a bitsliced batch into per-key subkeys, round-major:
+// subkeys[r][k] is round r's subkey for key k
+static inline void des_subkey_batch_extract(const des_subkey_batch *batch, uint64_t subkeys[DES_ROUNDS][DES_BATCH_KEYS]) {
+    uint64_t rows[64];
+
+    for (int r = 0; r < DES_ROUNDS; r++) {
+        memcpy(rows, batch->slice[r], sizeof(batch->slice[r]));
+        memset(rows + DES_SUBKEY_BITS, 0, sizeof(uint64_t) * (64 - DES_SUBKEY_BITS));
+        des_transpose64(rows);
+        for (int k = 0; k < DES_BATCH_KEYS; k++) {
+            subkeys[r][k] = rows[k] >> 16;
+        }
+    }
+}
+
+#endif // DES_KEY_SCHEDULE_H
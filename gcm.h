@@ -0,0 +1,444 @@
+#ifndef GCM_H
+#define GCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "block_modes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GCM_HAVE_CLMUL 1
+#else
+#define GCM_HAVE_CLMUL 0
+#endif
+
+// Galois/Counter Mode (NIST SP 800-38D) over any 16-byte block cipher backend
+// from block_modes.h.
+//
+// Encryption is a single pass: the CTR keystream is produced GCM_LANES blocks
+// at a time, and the resulting ciphertext blocks are fed to GHASH while they
+// are still in cache.
+//
+// GHASH has two implementations chosen when the key is set up:
+//   - PCLMULQDQ, when the CPU has it. The powers H^1..H^GCM_LANES are
+//     precomputed, so a group of blocks is folded in as
+//     Y' = (Y ^ C1)*H^n ^ C2*H^(n-1) ^ ... ^ Cn*H, with the unreduced
+//     products summed and a single reduction per group.
+//   - A portable 4-bit table (Shoup's method): sixteen multiples of H and
+//     one nibble-wide reduction table, two lookups per input byte.
+//
+// Usage: gcm_key_init once per key, then per message gcm_start,
+// gcm_aad (any number of calls, all before the text), gcm_encrypt or
+// gcm_decrypt (any number of calls, any lengths), and gcm_finish or
+// gcm_check.
+
+#define GCM_BLOCK_SIZE 16
+#define GCM_LANES 8
+#define GCM_TAG_SIZE 16
+
+typedef struct {
+    uint64_t table[16][2];                      // i*H for each nibble i, as hi/lo words
+    uint8_t powers[GCM_LANES][GCM_BLOCK_SIZE];  // H^(i + 1), byte-reflected for PCLMULQDQ
+    int use_clmul;                              // Clear to force the table implementation
+} ghash_key;
+
+// The key refers to the cipher passed to gcm_key_init rather than copying it,
+// so that cipher must outlive the key and every context started from it.
+template <class Cipher>
+struct gcm_key {
+    const Cipher *cipher;
+    ghash_key ghash;
+};
+
+template <class Cipher>
+struct gcm_context {
+    const gcm_key<Cipher> *key;
+    uint8_t y[GCM_BLOCK_SIZE];          // Running GHASH value
+    uint8_t j0[GCM_BLOCK_SIZE];         // Pre-counter block, encrypts the tag
+    uint8_t counter[GCM_BLOCK_SIZE];    // Next counter block
+    uint8_t keystream[GCM_BLOCK_SIZE];  // Keystream of the partial block
+    uint8_t partial[GCM_BLOCK_SIZE];    // Bytes of the partial AAD or ciphertext block
+    size_t partial_len;
+    uint64_t aad_len;
+    uint64_t text_len;
+};
+
+static const uint64_t ghash_rem_4bit[16] = {
+    0x0000ULL << 48, 0x1C20ULL << 48, 0x3840ULL << 48, 0x2460ULL << 48,
+    0x7080ULL << 48, 0x6CA0ULL << 48, 0x48C0ULL << 48, 0x54E0ULL << 48,
+    0xE100ULL << 48, 0xFD20ULL << 48, 0xD940ULL << 48, 0xC560ULL << 48,
+    0x9180ULL << 48, 0x8DA0ULL << 48, 0xA9C0ULL << 48, 0xB5E0ULL << 48
+};
+
+static inline uint64_t gcm_load_be64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline void gcm_store_be64(uint8_t *p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+// y = y * H with the 4-bit tables
+static inline void ghash_mult_4bit(const ghash_key *key, uint8_t y[GCM_BLOCK_SIZE]) {
+    int cnt = 15;
+    int nlo = y[15], nhi = nlo >> 4;
+    uint64_t zhi, zlo, rem;
+
+    nlo &= 0xF;
+    zhi = key->table[nlo][0];
+    zlo = key->table[nlo][1];
+    for (;;) {
+        rem = zlo & 0xF;
+        zlo = (zhi << 60) | (zlo >> 4);
+        zhi = (zhi >> 4) ^ ghash_rem_4bit[rem];
+        zhi ^= key->table[nhi][0];
+        zlo ^= key->table[nhi][1];
+        if (--cnt < 0) {
+            break;
+        }
+        nlo = y[cnt];
+        nhi = nlo >> 4;
+        nlo &= 0xF;
+        rem = zlo & 0xF;
+        zlo = (zhi << 60) | (zlo >> 4);
+        zhi = (zhi >> 4) ^ ghash_rem_4bit[rem];
+        zhi ^= key->table[nlo][0];
+        zlo ^= key->table[nlo][1];
+    }
+    gcm_store_be64(y, zhi);
+    gcm_store_be64(y + 8, zlo);
+}
+
+#if GCM_HAVE_CLMUL
+
+#define GCM_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+GCM_CLMUL_TARGET static inline __m128i ghash_reflect(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Accumulate the unreduced 256-bit product a*b into hi:lo
+GCM_CLMUL_TARGET static inline void ghash_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *hi) {
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(t2, _mm_srli_si128(t1, 8)));
+}
+
+// Reduce hi:lo modulo the GCM polynomial. The operands are bit-reflected, so
+// the product is first shifted left by one.
+GCM_CLMUL_TARGET static inline __m128i ghash_clmul_reduce(__m128i lo, __m128i hi) {
+    __m128i c0 = _mm_srli_epi32(lo, 31);
+    __m128i c1 = _mm_srli_epi32(hi, 31);
+    __m128i carry = _mm_srli_si128(c0, 12);
+
+    lo = _mm_or_si128(_mm_slli_epi32(lo, 1), _mm_slli_si128(c0, 4));
+    hi = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(hi, 1), _mm_slli_si128(c1, 4)), carry);
+
+    __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i b = _mm_srli_si128(a, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+
+    __m128i c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(c, b));
+    return _mm_xor_si128(hi, lo);
+}
+
+GCM_CLMUL_TARGET static inline void ghash_clmul_powers(ghash_key *key, const uint8_t h[GCM_BLOCK_SIZE]) {
+    __m128i hr = ghash_reflect(_mm_loadu_si128((const __m128i *)h));
+    __m128i power = hr;
+
+    _mm_storeu_si128((__m128i *)key->powers[0], hr);
+    for (int i = 1; i < GCM_LANES; i++) {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ghash_clmul_acc(power, hr, &lo, &hi);
+        power = ghash_clmul_reduce(lo, hi);
+        _mm_storeu_si128((__m128i *)key->powers[i], power);
+    }
+}
+
+GCM_CLMUL_TARGET static inline void ghash_clmul_blocks(const ghash_key *key, uint8_t y[GCM_BLOCK_SIZE],
+                                                       const uint8_t *data, size_t blocks) {
+    __m128i acc = ghash_reflect(_mm_loadu_si128((const __m128i *)y));
+    size_t i = 0;
+
+    // GCM_LANES blocks per reduction
+    for (; i + GCM_LANES <= blocks; i += GCM_LANES) {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        for (int l = 0; l < GCM_LANES; l++) {
+            __m128i x = ghash_reflect(_mm_loadu_si128((const __m128i *)(data + (i + l) * GCM_BLOCK_SIZE)));
+            if (l == 0) {
+                x = _mm_xor_si128(x, acc);
+            }
+            ghash_clmul_acc(x, _mm_loadu_si128((const __m128i *)key->powers[GCM_LANES - 1 - l]), &lo, &hi);
+        }
+        acc = ghash_clmul_reduce(lo, hi);
+    }
+
+    // The remaining blocks as one shorter group
+    size_t rest = blocks - i;
+    if (rest) {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        for (size_t l = 0; l < rest; l++) {
+            __m128i x = ghash_reflect(_mm_loadu_si128((const __m128i *)(data + (i + l) * GCM_BLOCK_SIZE)));
+            if (l == 0) {
+                x = _mm_xor_si128(x, acc);
+            }
+            ghash_clmul_acc(x, _mm_loadu_si128((const __m128i *)key->powers[rest - 1 - l]), &lo, &hi);
+        }
+        acc = ghash_clmul_reduce(lo, hi);
+    }
+    _mm_storeu_si128((__m128i *)y, ghash_reflect(acc));
+}
+
+#endif // GCM_HAVE_CLMUL
+
+// Precompute the GHASH tables for the hash key h = E(0^128)
+static inline void ghash_init(ghash_key *key, const uint8_t h[GCM_BLOCK_SIZE]) {
+    uint64_t vhi = gcm_load_be64(h), vlo = gcm_load_be64(h + 8);
+
+    memset(key, 0, sizeof(*key));
+    key->table[8][0] = vhi;
+    key->table[8][1] = vlo;
+    for (int i = 4; i > 0; i >>= 1) {
+        // Multiply by x: a right shift in GCM's reflected bit order
+        uint64_t reduce = (vlo & 1) ? 0xE100000000000000ULL : 0;
+        vlo = (vhi << 63) | (vlo >> 1);
+        vhi = (vhi >> 1) ^ reduce;
+        key->table[i][0] = vhi;
+        key->table[i][1] = vlo;
+    }
+    for (int i = 2; i <= 8; i <<= 1) {
+        for (int j = 1; j < i; j++) {
+            key->table[i + j][0] = key->table[i][0] ^ key->table[j][0];
+            key->table[i + j][1] = key->table[i][1] ^ key->table[j][1];
+        }
+    }
+
+#if GCM_HAVE_CLMUL
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+        ghash_clmul_powers(key, h);
+        key->use_clmul = 1;
+    }
+#endif
+}
+
+// Absorb whole 16-byte blocks into the GHASH value y
+static inline void ghash_blocks(const ghash_key *key, uint8_t y[GCM_BLOCK_SIZE], const uint8_t *data,
+                                size_t blocks) {
+#if GCM_HAVE_CLMUL
+    if (key->use_clmul) {
+        ghash_clmul_blocks(key, y, data, blocks);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < blocks; i++) {
+        xor_block<GCM_BLOCK_SIZE>(y, y, data + i * GCM_BLOCK_SIZE);
+        ghash_mult_4bit(key, y);
+    }
+}
+
+// Increment the low 32 bits of a counter block
+static inline void gcm_inc32(uint8_t *counter) {
+    for (int i = GCM_BLOCK_SIZE - 1; i >= GCM_BLOCK_SIZE - 4; i--) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+// Derive the hash key from the cipher, which must outlive key
+template <class Cipher>
+void gcm_key_init(gcm_key<Cipher> *key, const Cipher &cipher) {
+    static_assert(Cipher::block_size == GCM_BLOCK_SIZE, "GCM needs a 128-bit block cipher");
+    uint8_t h[GCM_BLOCK_SIZE] = {0};
+
+    key->cipher = &cipher;
+    cipher.encrypt_block(h, h);
+    ghash_init(&key->ghash, h);
+}
+
+// Begin a message. A 96-bit IV is used directly as the counter; any other
+// length is hashed into one.
+template <class Cipher>
+void gcm_start(gcm_context<Cipher> *ctx, const gcm_key<Cipher> *key, const uint8_t *iv, size_t iv_len) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->key = key;
+
+    if (iv_len == 12) {
+        memcpy(ctx->j0, iv, 12);
+        ctx->j0[15] = 1;
+    } else {
+        uint8_t block[GCM_BLOCK_SIZE] = {0};
+        size_t whole = iv_len / GCM_BLOCK_SIZE;
+        ghash_blocks(&key->ghash, ctx->j0, iv, whole);
+        if (iv_len % GCM_BLOCK_SIZE) {
+            memcpy(block, iv + whole * GCM_BLOCK_SIZE, iv_len % GCM_BLOCK_SIZE);
+            ghash_blocks(&key->ghash, ctx->j0, block, 1);
+        }
+        memset(block, 0, sizeof(block));
+        gcm_store_be64(block + 8, (uint64_t)iv_len * 8);
+        ghash_blocks(&key->ghash, ctx->j0, block, 1);
+    }
+    memcpy(ctx->counter, ctx->j0, GCM_BLOCK_SIZE);
+    gcm_inc32(ctx->counter);
+}
+
+// Feed len bytes into GHASH through the partial-block buffer
+template <class Cipher>
+void gcm_absorb(gcm_context<Cipher> *ctx, const uint8_t *data, size_t len) {
+    if (ctx->partial_len) {
+        size_t n = GCM_BLOCK_SIZE - ctx->partial_len < len ? GCM_BLOCK_SIZE - ctx->partial_len : len;
+        memcpy(ctx->partial + ctx->partial_len, data, n);
+        ctx->partial_len += n;
+        data += n;
+        len -= n;
+        if (ctx->partial_len < GCM_BLOCK_SIZE) {
+            return;
+        }
+        ghash_blocks(&ctx->key->ghash, ctx->y, ctx->partial, 1);
+        ctx->partial_len = 0;
+    }
+    ghash_blocks(&ctx->key->ghash, ctx->y, data, len / GCM_BLOCK_SIZE);
+    memcpy(ctx->partial, data + len / GCM_BLOCK_SIZE * GCM_BLOCK_SIZE, len % GCM_BLOCK_SIZE);
+    ctx->partial_len = len % GCM_BLOCK_SIZE;
+}
+
+// Zero-pad and hash a pending partial block
+template <class Cipher>
+void gcm_flush(gcm_context<Cipher> *ctx) {
+    if (ctx->partial_len) {
+        memset(ctx->partial + ctx->partial_len, 0, GCM_BLOCK_SIZE - ctx->partial_len);
+        ghash_blocks(&ctx->key->ghash, ctx->y, ctx->partial, 1);
+        ctx->partial_len = 0;
+    }
+}
+
+// Additional authenticated data. Returns -1 once text has been processed.
+template <class Cipher>
+int gcm_aad(gcm_context<Cipher> *ctx, const uint8_t *aad, size_t len) {
+    if (ctx->text_len) {
+        return -1;
+    }
+    gcm_absorb(ctx, aad, len);
+    ctx->aad_len += len;
+    return 0;
+}
+
+// Encrypt or decrypt len bytes; in and out may be the same buffer
+template <class Cipher>
+void gcm_crypt(gcm_context<Cipher> *ctx, const uint8_t *in, uint8_t *out, size_t len, int encrypting) {
+    const Cipher &cipher = *ctx->key->cipher;
+    const size_t B = GCM_BLOCK_SIZE;
+    uint8_t counters[GCM_LANES * B];
+    uint8_t keystream[GCM_LANES * B];
+    PERF_SCOPE(perf_primitive_of<Cipher>(nullptr), PERF_MODE_GCM, (len + B - 1) / B, len);
+
+    if (ctx->text_len == 0) {
+        gcm_flush(ctx);     // End of the AAD
+    }
+    ctx->text_len += len;
+
+    // Finish a partial block left by the previous call
+    size_t i = 0;
+    if (ctx->partial_len) {
+        size_t n = B - ctx->partial_len < len ? B - ctx->partial_len : len;
+        for (; i < n; i++) {
+            uint8_t c = encrypting ? in[i] ^ ctx->keystream[ctx->partial_len + i] : in[i];
+            out[i] = in[i] ^ ctx->keystream[ctx->partial_len + i];
+            ctx->partial[ctx->partial_len + i] = c;
+        }
+        ctx->partial_len += n;
+        if (ctx->partial_len < B) {
+            return;
+        }
+        ghash_blocks(&ctx->key->ghash, ctx->y, ctx->partial, 1);
+        ctx->partial_len = 0;
+    }
+
+    // Whole blocks, GCM_LANES at a time; the hash always runs over the
+    // ciphertext, so decryption hashes before it overwrites in place
+    while (i + B <= len) {
+        size_t blocks = (len - i) / B < GCM_LANES ? (len - i) / B : GCM_LANES;
+        for (size_t l = 0; l < blocks; l++) {
+            memcpy(counters + l * B, ctx->counter, B);
+            gcm_inc32(ctx->counter);
+        }
+        cipher_encrypt_blocks(cipher, counters, keystream, blocks);
+        if (!encrypting) {
+            ghash_blocks(&ctx->key->ghash, ctx->y, in + i, blocks);
+        }
+        for (size_t l = 0; l < blocks; l++) {
+            xor_block<GCM_BLOCK_SIZE>(out + i + l * B, in + i + l * B, keystream + l * B);
+        }
+        if (encrypting) {
+            ghash_blocks(&ctx->key->ghash, ctx->y, out + i, blocks);
+        }
+        i += blocks * B;
+    }
+
+    // Start a new partial block with the tail
+    if (i < len) {
+        cipher.encrypt_block(ctx->counter, ctx->keystream);
+        gcm_inc32(ctx->counter);
+        ctx->partial_len = len - i;
+        for (size_t k = 0; k < ctx->partial_len; k++) {
+            ctx->partial[k] = encrypting ? in[i + k] ^ ctx->keystream[k] : in[i + k];
+            out[i + k] = in[i + k] ^ ctx->keystream[k];
+        }
+    }
+}
+
+template <class Cipher>
+void gcm_encrypt(gcm_context<Cipher> *ctx, const uint8_t *in, uint8_t *out, size_t len) {
+    gcm_crypt(ctx, in, out, len, 1);
+}
+
+template <class Cipher>
+void gcm_decrypt(gcm_context<Cipher> *ctx, const uint8_t *in, uint8_t *out, size_t len) {
+    gcm_crypt(ctx, in, out, len, 0);
+}
+
+// Produce the authentication tag (up to 16 bytes)
+template <class Cipher>
+void gcm_finish(gcm_context<Cipher> *ctx, uint8_t *tag, size_t tag_len) {
+    uint8_t block[GCM_BLOCK_SIZE];
+
+    gcm_flush(ctx);
+    gcm_store_be64(block, ctx->aad_len * 8);
+    gcm_store_be64(block + 8, ctx->text_len * 8);
+    ghash_blocks(&ctx->key->ghash, ctx->y, block, 1);
+
+    ctx->key->cipher->encrypt_block(ctx->j0, block);
+    xor_block<GCM_BLOCK_SIZE>(block, block, ctx->y);
+    memcpy(tag, block, tag_len < GCM_BLOCK_SIZE ? tag_len : GCM_BLOCK_SIZE);
+}
+
+// Compare against a received tag in constant time. Returns 0 if it matches.
+template <class Cipher>
+int gcm_check(gcm_context<Cipher> *ctx, const uint8_t *tag, size_t tag_len) {
+    uint8_t expected[GCM_BLOCK_SIZE];
+    uint8_t diff = 0;
+
+    if (tag_len == 0 || tag_len > GCM_BLOCK_SIZE) {
+        return -1;
+    }
+    gcm_finish(ctx, expected, tag_len);
+    for (size_t i = 0; i < tag_len; i++) {
+        diff |= expected[i] ^ tag[i];
+    }
+    return diff ? -1 : 0;
+}
+
+#endif // GCM_H
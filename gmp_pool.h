@@ -0,0 +1,209 @@
+#ifndef GMP_POOL_H
+#define GMP_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+// Pooled memory functions for GMP, installed with mp_set_memory_functions.
+//
+// Every thread keeps its own free lists, one per power-of-two size class, so
+// the RSA paths never contend on the global malloc lock once the pools are
+// warm. The pools are sized from the modulus: gmp_pool_init(bits) preloads
+// each thread's lists with blocks big enough for a product of two residues.
+// Freed blocks are wiped over the bytes GMP was using, and a realloc that
+// shrinks a block in place wipes the bytes it gives up, so blocks on the free
+// lists hold no old limbs. Per-thread counters report how many allocations
+// each RSA operation still performs once the workspace is set up.
+
+#define GMP_POOL_MIN_SHIFT 4                 // Smallest class: 16 bytes
+#define GMP_POOL_CLASSES 16                  // Largest class: 512 KiB
+#define GMP_POOL_MAX_FREE 64                 // Blocks kept per class
+#define GMP_POOL_PRELOAD 8                   // Blocks preloaded per class
+
+typedef struct {
+    unsigned long allocs;       // Calls to the allocate function
+    unsigned long reallocs;     // Calls to the reallocate function
+    unsigned long frees;        // Calls to the free function
+    unsigned long pool_hits;    // Requests served from a free list
+    unsigned long ops;          // Operations recorded with gmp_pool_count_op
+} gmp_pool_stats;
+
+typedef struct gmp_pool_block {
+    struct gmp_pool_block *next;
+} gmp_pool_block;
+
+struct gmp_pool {
+    gmp_pool_block *free_list[GMP_POOL_CLASSES];
+    int free_count[GMP_POOL_CLASSES];
+    gmp_pool_stats stats;
+    int preloaded;
+
+    ~gmp_pool() {
+        for (int c = 0; c < GMP_POOL_CLASSES; c++) {
+            while (free_list[c] != NULL) {
+                gmp_pool_block *block = free_list[c];
+                free_list[c] = block->next;
+                free(block);
+            }
+        }
+    }
+};
+
+static thread_local gmp_pool gmp_pool_local;
+static size_t gmp_pool_preload_bytes = 0;
+
+// Overwrite memory in a way the compiler may not optimise out
+static inline void gmp_pool_zero(void *ptr, size_t size) {
+    explicit_bzero(ptr, size);
+}
+
+// Size class for a request, or -1 if it is too large to pool
+static inline int gmp_pool_class(size_t size) {
+    int c = 0;
+    size_t capacity = (size_t)1 << GMP_POOL_MIN_SHIFT;
+    while (capacity < size) {
+        capacity <<= 1;
+        if (++c == GMP_POOL_CLASSES) {
+            return -1;
+        }
+    }
+    return c;
+}
+
+static inline size_t gmp_pool_class_size(int c) {
+    return (size_t)1 << (GMP_POOL_MIN_SHIFT + c);
+}
+
+static void gmp_pool_push(gmp_pool *pool, int c, void *ptr) {
+    gmp_pool_block *block = (gmp_pool_block *)ptr;
+    block->next = pool->free_list[c];
+    pool->free_list[c] = block;
+    pool->free_count[c]++;
+}
+
+// Fill this thread's free lists up to the configured modulus size
+static void gmp_pool_preload(gmp_pool *pool) {
+    pool->preloaded = 1;
+    int top = gmp_pool_class(gmp_pool_preload_bytes);
+    if (gmp_pool_preload_bytes == 0 || top < 0) {
+        return;
+    }
+    for (int c = 0; c <= top; c++) {
+        for (int i = 0; i < GMP_POOL_PRELOAD; i++) {
+            void *ptr = malloc(gmp_pool_class_size(c));
+            if (ptr == NULL) {
+                return;
+            }
+            gmp_pool_push(pool, c, ptr);
+        }
+    }
+}
+
+static void *gmp_pool_take(gmp_pool *pool, size_t size) {
+    if (!pool->preloaded) {
+        gmp_pool_preload(pool);
+    }
+
+    int c = gmp_pool_class(size);
+    void *ptr;
+    if (c >= 0 && pool->free_list[c] != NULL) {
+        gmp_pool_block *block = pool->free_list[c];
+        pool->free_list[c] = block->next;
+        pool->free_count[c]--;
+        pool->stats.pool_hits++;
+        return block;
+    }
+
+    ptr = malloc(c >= 0 ? gmp_pool_class_size(c) : size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        abort();
+    }
+    return ptr;
+}
+
+static void gmp_pool_give(gmp_pool *pool, void *ptr, size_t size) {
+    // GMP only ever wrote the first size bytes; anything a shrink released
+    // was wiped by gmp_pool_realloc
+    int c = gmp_pool_class(size);
+    gmp_pool_zero(ptr, size);
+
+    if (c >= 0 && pool->free_count[c] < GMP_POOL_MAX_FREE) {
+        gmp_pool_push(pool, c, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+static void *gmp_pool_alloc(size_t size) {
+    gmp_pool_local.stats.allocs++;
+    return gmp_pool_take(&gmp_pool_local, size);
+}
+
+static void *gmp_pool_realloc(void *ptr, size_t old_size, size_t new_size) {
+    gmp_pool_local.stats.reallocs++;
+
+    // Blocks are allocated at their full class size, so resizing within the
+    // class needs no copy. A shrink wipes the bytes it gives up.
+    int old_class = gmp_pool_class(old_size);
+    if (old_class >= 0 && old_class == gmp_pool_class(new_size)) {
+        if (new_size < old_size) {
+            gmp_pool_zero((unsigned char *)ptr + new_size, old_size - new_size);
+        }
+        return ptr;
+    }
+
+    void *fresh = gmp_pool_take(&gmp_pool_local, new_size);
+    memcpy(fresh, ptr, old_size < new_size ? old_size : new_size);
+    gmp_pool_give(&gmp_pool_local, ptr, old_size);
+    return fresh;
+}
+
+static void gmp_pool_free(void *ptr, size_t size) {
+    gmp_pool_local.stats.frees++;
+    gmp_pool_give(&gmp_pool_local, ptr, size);
+}
+
+// Install the pooled allocator. Must run before any GMP variable is
+// initialised. modulus_bits sizes the preloaded blocks of every thread.
+static inline void gmp_pool_init(unsigned long modulus_bits) {
+    // A product of two residues needs twice the modulus, plus a spare limb
+    gmp_pool_preload_bytes = (2 * modulus_bits + GMP_NUMB_BITS) / 8;
+    mp_set_memory_functions(gmp_pool_alloc, gmp_pool_realloc, gmp_pool_free);
+}
+
+// Record that one operation (an encryption, a decryption, ...) finished
+static inline void gmp_pool_count_op(void) {
+    gmp_pool_local.stats.ops++;
+}
+
+// Counters for the calling thread
+static inline gmp_pool_stats gmp_pool_get_stats(void) {
+    return gmp_pool_local.stats;
+}
+
+// Counters for the calling thread since an earlier gmp_pool_get_stats, so
+// setup and teardown allocations stay out of the per-operation figures
+static inline gmp_pool_stats gmp_pool_stats_since(const gmp_pool_stats *start) {
+    gmp_pool_stats s = gmp_pool_get_stats();
+    s.allocs -= start->allocs;
+    s.reallocs -= start->reallocs;
+    s.frees -= start->frees;
+    s.pool_hits -= start->pool_hits;
+    s.ops -= start->ops;
+    return s;
+}
+
+static inline void gmp_pool_print_stats(const gmp_pool_stats *stats) {
+    gmp_pool_stats s = *stats;
+    printf("GMP allocator: %lu allocs, %lu reallocs, %lu frees, %lu pool hits",
+           s.allocs, s.reallocs, s.frees, s.pool_hits);
+    if (s.ops > 0) {
+        printf(", %.2f allocs per operation", (double)(s.allocs + s.reallocs) / s.ops);
+    }
+    printf("\n");
+}
+
+#endif // GMP_POOL_H
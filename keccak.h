@@ -0,0 +1,444 @@
+#ifndef KECCAK_H
+#define KECCAK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "perf_counters.h"
+
+// Keccak-f[1600] sponge with SHA-3 (FIPS 202), KMAC (SP 800-185) and
+// HMAC-SHA3.
+//
+// The keyed constructions put everything that depends only on the key into a
+// key object: KMAC absorbs its padded "KMAC"/customization prefix and the
+// padded key, HMAC absorbs K0 ^ ipad and K0 ^ opad. Those prefixes are whole
+// rate blocks, so the stored state sits on a block boundary and a MAC copies
+// it instead of paying the one to three permutations of the key again.
+//
+// The batch functions MAC many messages under one key KECCAK_LANES at a time
+// with keccak_f1600_x4, which runs the permutation on four independent
+// states stored lane-interleaved so each step is one vector operation.
+
+#define KECCAK_ROUNDS 24
+#define KECCAK_LANES 4
+#define KECCAK_MAX_RATE 168             // SHAKE128/KMAC128
+
+#define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
+
+// Keccak round constants
+static const uint64_t keccak_rc[KECCAK_ROUNDS] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+// Rho rotations and pi destinations along the lane cycle starting at lane 1
+static const int keccak_rotc[24] = {
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+static const int keccak_piln[24] = {
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+typedef struct {
+    uint64_t st[25];                    // Lane x + 5y
+    size_t rate;                        // Bytes per block
+    size_t pos;                         // Byte position within the current block
+} keccak_sponge;
+
+typedef struct {
+    keccak_sponge keyed;                // State after the prefix and the key
+} kmac_key;
+
+typedef struct {
+    keccak_sponge inner;                // State after K0 ^ ipad
+    keccak_sponge outer;                // State after K0 ^ opad
+    size_t digest_len;
+} hmac_sha3_key;
+
+static inline uint64_t keccak_load64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// Keccak-f[1600] permutation
+static inline void keccak_f1600(uint64_t st[25]) {
+    uint64_t bc[5], t;
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_PERMUTE, 1, 200);
+
+    for (int round = 0; round < KECCAK_ROUNDS; round++) {
+        // Theta
+        for (int i = 0; i < 5; i++) {
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        }
+        for (int i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+            for (int j = 0; j < 25; j += 5) {
+                st[j + i] ^= t;
+            }
+        }
+
+        // Rho and pi
+        t = st[1];
+        for (int i = 0; i < 24; i++) {
+            int j = keccak_piln[i];
+            bc[0] = st[j];
+            st[j] = ROTL64(t, keccak_rotc[i]);
+            t = bc[0];
+        }
+
+        // Chi
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++) {
+                bc[i] = st[j + i];
+            }
+            for (int i = 0; i < 5; i++) {
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+            }
+        }
+
+        // Iota
+        st[0] ^= keccak_rc[round];
+    }
+}
+
+// Keccak-f[1600] on KECCAK_LANES states at once: st[i][l] is lane i of
+// state l. The innermost loops run across the states, which the compiler
+// turns into vector instructions.
+static inline void keccak_f1600_x4(uint64_t st[25][KECCAK_LANES]) {
+    uint64_t bc[5][KECCAK_LANES], t[KECCAK_LANES], u[KECCAK_LANES];
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_PERMUTE, KECCAK_LANES, 200 * KECCAK_LANES);
+
+    for (int round = 0; round < KECCAK_ROUNDS; round++) {
+        for (int i = 0; i < 5; i++) {
+            for (int l = 0; l < KECCAK_LANES; l++) {
+                bc[i][l] = st[i][l] ^ st[i + 5][l] ^ st[i + 10][l] ^ st[i + 15][l] ^ st[i + 20][l];
+            }
+        }
+        for (int i = 0; i < 5; i++) {
+            for (int l = 0; l < KECCAK_LANES; l++) {
+                t[l] = bc[(i + 4) % 5][l] ^ ROTL64(bc[(i + 1) % 5][l], 1);
+            }
+            for (int j = 0; j < 25; j += 5) {
+                for (int l = 0; l < KECCAK_LANES; l++) {
+                    st[j + i][l] ^= t[l];
+                }
+            }
+        }
+
+        memcpy(t, st[1], sizeof(t));
+        for (int i = 0; i < 24; i++) {
+            int j = keccak_piln[i], r = keccak_rotc[i];
+            for (int l = 0; l < KECCAK_LANES; l++) {
+                u[l] = st[j][l];
+                st[j][l] = ROTL64(t[l], r);
+                t[l] = u[l];
+            }
+        }
+
+        for (int j = 0; j < 25; j += 5) {
+            memcpy(bc, st[j], sizeof(bc));
+            for (int i = 0; i < 5; i++) {
+                for (int l = 0; l < KECCAK_LANES; l++) {
+                    st[j + i][l] ^= (~bc[(i + 1) % 5][l]) & bc[(i + 2) % 5][l];
+                }
+            }
+        }
+
+        for (int l = 0; l < KECCAK_LANES; l++) {
+            st[0][l] ^= keccak_rc[round];
+        }
+    }
+}
+
+static inline void keccak_init(keccak_sponge *s, size_t rate) {
+    memset(s->st, 0, sizeof(s->st));
+    s->rate = rate;
+    s->pos = 0;
+}
+
+static inline void keccak_absorb(keccak_sponge *s, const uint8_t *data, size_t len) {
+    // Whole blocks straight from the input
+    if (s->pos == 0) {
+        while (len >= s->rate) {
+            for (size_t i = 0; i < s->rate / 8; i++) {
+                s->st[i] ^= keccak_load64(data + 8 * i);
+            }
+            keccak_f1600(s->st);
+            data += s->rate;
+            len -= s->rate;
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        s->st[s->pos / 8] ^= (uint64_t)data[i] << (8 * (s->pos % 8));
+        if (++s->pos == s->rate) {
+            keccak_f1600(s->st);
+            s->pos = 0;
+        }
+    }
+}
+
+// Absorb zeros up to the next block boundary (the tail of bytepad)
+static inline void keccak_zero_pad(keccak_sponge *s) {
+    if (s->pos != 0) {
+        keccak_f1600(s->st);
+        s->pos = 0;
+    }
+}
+
+// Apply the domain separation bits and pad10*1, then switch to squeezing
+static inline void keccak_pad(keccak_sponge *s, uint8_t domain) {
+    s->st[s->pos / 8] ^= (uint64_t)domain << (8 * (s->pos % 8));
+    s->st[(s->rate - 1) / 8] ^= 0x80ULL << (8 * ((s->rate - 1) % 8));
+    keccak_f1600(s->st);
+    s->pos = 0;
+}
+
+static inline void keccak_squeeze(keccak_sponge *s, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (s->pos == s->rate) {
+            keccak_f1600(s->st);
+            s->pos = 0;
+        }
+        out[i] = (uint8_t)(s->st[s->pos / 8] >> (8 * (s->pos % 8)));
+        s->pos++;
+    }
+}
+
+// SHA3-224/256/384/512, selected by the digest length in bytes
+static inline void sha3(const uint8_t *message, size_t len, uint8_t *digest, size_t digest_len) {
+    keccak_sponge s;
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_HASH, 1, len);
+    keccak_init(&s, 200 - 2 * digest_len);
+    keccak_absorb(&s, message, len);
+    keccak_pad(&s, 0x06);
+    keccak_squeeze(&s, digest, digest_len);
+}
+
+// SP 800-185 left_encode / right_encode. Returns the encoded length.
+static inline size_t sp800_185_encode(uint64_t x, uint8_t out[9], int left) {
+    uint8_t bytes[8];
+    size_t n = 0, o = 0;
+
+    do {
+        bytes[n++] = (uint8_t)x;
+        x >>= 8;
+    } while (x != 0);
+    if (left) {
+        out[o++] = (uint8_t)n;
+    }
+    for (size_t i = n; i > 0; i--) {
+        out[o++] = bytes[i - 1];
+    }
+    if (!left) {
+        out[o++] = (uint8_t)n;
+    }
+    return o;
+}
+
+// Absorb encode_string(data)
+static inline void keccak_absorb_string(keccak_sponge *s, const uint8_t *data, size_t len) {
+    uint8_t enc[9];
+    keccak_absorb(s, enc, sp800_185_encode((uint64_t)len * 8, enc, 1));
+    keccak_absorb(s, data, len);
+}
+
+// Set up a KMAC key (security 128 or 256) with an optional customization
+// string. The prefix and key are absorbed here, once.
+static inline void kmac_key_init(kmac_key *k, int security, const uint8_t *key, size_t key_len, const uint8_t *custom,
+                                 size_t custom_len) {
+    keccak_sponge *s = &k->keyed;
+    uint8_t enc[9];
+    size_t rate = security == 128 ? 168 : 136;
+    PERF_KEY_SETUP(PERF_KECCAK, 1);
+
+    keccak_init(s, rate);
+    keccak_absorb(s, enc, sp800_185_encode(rate, enc, 1));
+    keccak_absorb_string(s, (const uint8_t *)"KMAC", 4);
+    keccak_absorb_string(s, custom, custom_len);
+    keccak_zero_pad(s);
+
+    keccak_absorb(s, enc, sp800_185_encode(rate, enc, 1));
+    keccak_absorb_string(s, key, key_len);
+    keccak_zero_pad(s);
+}
+
+// Streaming KMAC: start from the keyed state, absorb the message, finish
+static inline void kmac_start(const kmac_key *k, keccak_sponge *s) {
+    *s = k->keyed;
+}
+
+static inline void kmac_finish(keccak_sponge *s, uint8_t *mac, size_t mac_len) {
+    uint8_t enc[9];
+    keccak_absorb(s, enc, sp800_185_encode((uint64_t)mac_len * 8, enc, 0));
+    keccak_pad(s, 0x04);
+    keccak_squeeze(s, mac, mac_len);
+}
+
+// One-shot KMAC of a message
+static inline void kmac(const kmac_key *k, const uint8_t *message, size_t len, uint8_t *mac, size_t mac_len) {
+    keccak_sponge s;
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_MAC, 1, len);
+    kmac_start(k, &s);
+    keccak_absorb(&s, message, len);
+    kmac_finish(&s, mac, mac_len);
+}
+
+// Set up an HMAC-SHA3 key for a digest of 28, 32, 48 or 64 bytes
+static inline void hmac_sha3_key_init(hmac_sha3_key *k, size_t digest_len, const uint8_t *key, size_t key_len) {
+    size_t rate = 200 - 2 * digest_len;
+    uint8_t k0[KECCAK_MAX_RATE] = {0}, pad[KECCAK_MAX_RATE];
+    PERF_KEY_SETUP(PERF_KECCAK, 1);
+
+    if (key_len > rate) {
+        sha3(key, key_len, k0, digest_len);
+    } else {
+        memcpy(k0, key, key_len);
+    }
+    k->digest_len = digest_len;
+
+    for (size_t i = 0; i < rate; i++) {
+        pad[i] = k0[i] ^ 0x36;
+    }
+    keccak_init(&k->inner, rate);
+    keccak_absorb(&k->inner, pad, rate);
+    for (size_t i = 0; i < rate; i++) {
+        pad[i] = k0[i] ^ 0x5c;
+    }
+    keccak_init(&k->outer, rate);
+    keccak_absorb(&k->outer, pad, rate);
+}
+
+// One-shot HMAC-SHA3; mac receives digest_len bytes
+static inline void hmac_sha3(const hmac_sha3_key *k, const uint8_t *message, size_t len, uint8_t *mac) {
+    keccak_sponge s = k->inner;
+    uint8_t inner[64];
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_MAC, 1, len);
+
+    keccak_absorb(&s, message, len);
+    keccak_pad(&s, 0x06);
+    keccak_squeeze(&s, inner, k->digest_len);
+
+    s = k->outer;
+    keccak_absorb(&s, inner, k->digest_len);
+    keccak_pad(&s, 0x06);
+    keccak_squeeze(&s, mac, k->digest_len);
+}
+
+// Absorb up to KECCAK_LANES messages, each followed by the same suffix and
+// padded with the given domain bits, starting every one from the block-aligned
+// state start. done[l] receives message l's state ready for squeezing.
+static inline void keccak_absorb_x4(const keccak_sponge *start, const uint8_t *const messages[], const size_t lens[],
+                                    size_t count, const uint8_t *suffix, size_t suffix_len, uint8_t domain,
+                                    keccak_sponge done[KECCAK_LANES]) {
+    const size_t rate = start->rate;
+    uint64_t st[25][KECCAK_LANES];
+    uint8_t tail[KECCAK_LANES][2 * KECCAK_MAX_RATE];
+    size_t full[KECCAK_LANES], blocks[KECCAK_LANES], most = 0;
+
+    // Each message is its whole blocks, read in place, then one or two
+    // blocks holding the remainder, the suffix and the padding
+    for (size_t l = 0; l < count; l++) {
+        size_t rest = lens[l] % rate;
+        full[l] = lens[l] / rate;
+        size_t tail_len = rest + suffix_len + 1 <= rate ? rate : 2 * rate;
+        memset(tail[l], 0, tail_len);
+        memcpy(tail[l], messages[l] + full[l] * rate, rest);
+        if (suffix_len) {
+            memcpy(tail[l] + rest, suffix, suffix_len);
+        }
+        tail[l][rest + suffix_len] ^= domain;
+        tail[l][tail_len - 1] ^= 0x80;
+        blocks[l] = full[l] + tail_len / rate;
+        most = blocks[l] > most ? blocks[l] : most;
+    }
+    for (int i = 0; i < 25; i++) {
+        for (int l = 0; l < KECCAK_LANES; l++) {
+            st[i][l] = start->st[i];
+        }
+    }
+
+    // Lockstep over the blocks; a message that ends early has its state
+    // taken out right after its last permutation
+    for (size_t b = 0; b < most; b++) {
+        for (size_t l = 0; l < count; l++) {
+            if (b >= blocks[l]) {
+                continue;
+            }
+            const uint8_t *block = b < full[l] ? messages[l] + b * rate : tail[l] + (b - full[l]) * rate;
+            for (size_t i = 0; i < rate / 8; i++) {
+                st[i][l] ^= keccak_load64(block + 8 * i);
+            }
+        }
+        keccak_f1600_x4(st);
+        for (size_t l = 0; l < count; l++) {
+            if (b + 1 == blocks[l]) {
+                for (int i = 0; i < 25; i++) {
+                    done[l].st[i] = st[i][l];
+                }
+                done[l].rate = rate;
+                done[l].pos = 0;
+            }
+        }
+    }
+}
+
+// Total length of a batch of messages
+static inline uint64_t keccak_total_length(const size_t lens[], size_t count) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += lens[i];
+    }
+    return total;
+}
+
+// KMAC count messages under one key; mac i is written to macs + i * mac_len
+static inline void kmac_batch(const kmac_key *k, const uint8_t *const messages[], const size_t lens[], size_t count,
+                              uint8_t *macs, size_t mac_len) {
+    keccak_sponge done[KECCAK_LANES];
+    uint8_t suffix[9];
+    size_t suffix_len = sp800_185_encode((uint64_t)mac_len * 8, suffix, 0);
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_MAC, count, keccak_total_length(lens, count));
+
+    for (size_t i = 0; i < count; i += KECCAK_LANES) {
+        size_t n = count - i < KECCAK_LANES ? count - i : KECCAK_LANES;
+        keccak_absorb_x4(&k->keyed, messages + i, lens + i, n, suffix, suffix_len, 0x04, done);
+        for (size_t l = 0; l < n; l++) {
+            keccak_squeeze(&done[l], macs + (i + l) * mac_len, mac_len);
+        }
+    }
+}
+
+// HMAC-SHA3 count messages under one key; mac i is written to
+// macs + i * digest_len
+static inline void hmac_sha3_batch(const hmac_sha3_key *k, const uint8_t *const messages[], const size_t lens[],
+                                   size_t count, uint8_t *macs) {
+    keccak_sponge done[KECCAK_LANES];
+    uint8_t inner[KECCAK_LANES][64];
+    const uint8_t *inner_ptrs[KECCAK_LANES];
+    size_t inner_lens[KECCAK_LANES];
+    PERF_SCOPE(PERF_KECCAK, PERF_MODE_MAC, count, keccak_total_length(lens, count));
+
+    for (size_t i = 0; i < count; i += KECCAK_LANES) {
+        size_t n = count - i < KECCAK_LANES ? count - i : KECCAK_LANES;
+        keccak_absorb_x4(&k->inner, messages + i, lens + i, n, NULL, 0, 0x06, done);
+        for (size_t l = 0; l < n; l++) {
+            keccak_squeeze(&done[l], inner[l], k->digest_len);
+            inner_ptrs[l] = inner[l];
+            inner_lens[l] = k->digest_len;
+        }
+        keccak_absorb_x4(&k->outer, inner_ptrs, inner_lens, n, NULL, 0, 0x06, done);
+        for (size_t l = 0; l < n; l++) {
+            keccak_squeeze(&done[l], macs + (i + l) * k->digest_len, k->digest_len);
+        }
+    }
+}
+
+#endif // KECCAK_H
@@ -0,0 +1,152 @@
+#ifndef NGRAM_TABLE_H
+#define NGRAM_TABLE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// English n-gram statistics for the frequency attacks.
+//
+// Tables are built from corpora by "16.n-gram table builder" and stored as
+// dense arrays of log10 probabilities, one per n = 1..4, indexed by the
+// letters in base 26 (the quadgram ABCD is entry ((0*26+1)*26+2)*26+3).
+// Unseen n-grams hold a floor value instead of -inf, so scoring is a plain
+// sum of lookups. The file is mapped read-only and used in place: the header
+// is checked and the arrays are addressed directly, with no parsing.
+//
+// The layout is native little-endian: the header, then each table starting
+// on a 64-byte boundary.
+
+#define NGRAM_MAGIC "NGRAMTB"
+#define NGRAM_VERSION 1
+#define NGRAM_ALPHABET 26
+#define NGRAM_MAX_N 4
+#define NGRAM_ALIGN 64
+#define NGRAM_DEFAULT_PATH "english_ngrams.bin"
+
+typedef struct {
+    char magic[8];                      // NGRAM_MAGIC
+    uint32_t version;                   // NGRAM_VERSION
+    uint32_t alphabet;                  // NGRAM_ALPHABET
+    uint32_t max_n;                     // NGRAM_MAX_N
+    uint32_t header_size;               // sizeof(ngram_file_header)
+    uint64_t offset[NGRAM_MAX_N];       // File offset of the (i + 1)-gram table
+    uint64_t total[NGRAM_MAX_N];        // Number of (i + 1)-grams counted
+    float floor[NGRAM_MAX_N];           // Log10 probability given to unseen (i + 1)-grams
+} ngram_file_header;
+
+typedef struct {
+    const ngram_file_header *header;
+    const float *table[NGRAM_MAX_N];    // table[n - 1] has 26^n entries
+    size_t size;
+} ngram_table;
+
+// Unigram percentages used when no table file is available
+static const double ngram_english_freq[NGRAM_ALPHABET] = {
+    8.167, 1.492, 2.782, 4.253, 12.702, 2.228, 2.015, 6.094, 6.966, 0.153,
+    0.772, 4.025, 2.406, 6.749, 7.507, 1.929, 0.095, 5.987, 6.327, 9.056,
+    2.758, 0.978, 2.360, 0.150, 1.974, 0.074
+};
+
+// Number of entries in the n-gram table
+static inline uint64_t ngram_entries(int n) {
+    uint64_t entries = 1;
+    for (int i = 0; i < n; i++) {
+        entries *= NGRAM_ALPHABET;
+    }
+    return entries;
+}
+
+// Letter index 0..25, or -1 for anything that is not a letter
+static inline int ngram_letter(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a';
+    }
+    return -1;
+}
+
+// Map a table file and check its header. Returns 0 on success, -1 otherwise.
+static inline int ngram_table_open(const char *path, ngram_table *t) {
+    memset(t, 0, sizeof(*t));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ngram_file_header)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const ngram_file_header *h = (const ngram_file_header *)map;
+    int ok = memcmp(h->magic, NGRAM_MAGIC, sizeof(h->magic)) == 0 && h->version == NGRAM_VERSION &&
+             h->alphabet == NGRAM_ALPHABET && h->max_n == NGRAM_MAX_N && h->header_size == sizeof(ngram_file_header);
+    for (int n = 1; ok && n <= NGRAM_MAX_N; n++) {
+        uint64_t offset = h->offset[n - 1];
+        ok = offset % NGRAM_ALIGN == 0 && offset >= sizeof(ngram_file_header) &&
+             offset + ngram_entries(n) * sizeof(float) <= (uint64_t)st.st_size;
+        if (ok) {
+            t->table[n - 1] = (const float *)((const char *)map + offset);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: not a version %d n-gram table\n", path, NGRAM_VERSION);
+        munmap(map, (size_t)st.st_size);
+        memset(t, 0, sizeof(*t));
+        return -1;
+    }
+    t->header = h;
+    t->size = (size_t)st.st_size;
+    return 0;
+}
+
+static inline void ngram_table_close(ngram_table *t) {
+    if (t->header != NULL) {
+        munmap((void *)t->header, t->size);
+    }
+    memset(t, 0, sizeof(*t));
+}
+
+// Log10 likelihood of the letters of text under the n-gram model. Characters
+// that are not letters are skipped, so spacing and punctuation do not matter.
+static inline double ngram_score(const ngram_table *t, int n, const char *text, size_t length) {
+    const float *table = t->table[n - 1];
+    uint32_t modulus = (uint32_t)ngram_entries(n - 1);
+    uint32_t index = 0;
+    int seen = 0;
+    double score = 0.0;
+
+    for (size_t i = 0; i < length; i++) {
+        int letter = ngram_letter(text[i]);
+        if (letter < 0) {
+            continue;
+        }
+        index = (index % modulus) * NGRAM_ALPHABET + (uint32_t)letter;
+        if (++seen >= n) {
+            score += table[index];
+        }
+    }
+    return score;
+}
+
+// Unigram percentages from a table, in the form the chi-squared tests use
+static inline void ngram_unigram_percent(const ngram_table *t, double freq[NGRAM_ALPHABET]) {
+    for (int i = 0; i < NGRAM_ALPHABET; i++) {
+        freq[i] = pow(10.0, t->table[0][i]) * 100.0;
+    }
+}
+
+#endif // NGRAM_TABLE_H